@@ -0,0 +1,316 @@
+// timings of the per-point paths of every regression, for comparing versions,
+// and with --convergence the time the descent takes to reach the closed-form solution:
+// g++ -std=c++17 -O2 bench.cpp -pthread -o bench && ./bench --json bench.json
+#define HEADLESS
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include "point_store.hpp"
+#include "regressions.hpp"
+
+static void usage() {
+    std::fprintf(stderr,
+        "usage: bench [options]\n"
+        "  --max N             the largest number of points, the sweep goes 10, 100, ... up to it (default 10000000)\n"
+        "  --family NAME       linear, quadratic, power, exponential or all (default all)\n"
+        "  --min-time S        seconds each measurement runs at least (default 0.2)\n"
+        "  --moments           take the descent gradient from the running sums\n"
+        "  --threads N         threads for the scans (default all cores)\n"
+        "  --json FILE         write the results as json to FILE, - for stdout\n"
+        "  --convergence       time the descent from its starting point to the solution instead, both optimizers\n"
+        "  --points N          points of each convergence dataset (default 100000)\n"
+        "  --epsilon E         converged when every parameter is within E of the solution, relatively (default 1e-3)\n"
+        "  --time-limit S      seconds after which a descent counts as not converged (default 10)\n");
+}
+
+struct Result {
+    const char *family, *benchmark;
+    std::size_t points;      // per iteration
+    std::size_t bytes;       // read per iteration
+    long iterations;
+    double seconds;
+    double ns_per_point() const { return seconds * 1e9 / (double(iterations) * points); }
+    double gb_per_second() const { return double(bytes) * iterations / seconds / 1e9; }
+    double iterations_per_second() const { return iterations / seconds; }
+};
+
+// calls run() until min_time has passed, in growing batches so the clock is read rarely for small n
+template <class Run>
+static Result measure(const char *family, const char *benchmark, std::size_t points, std::size_t bytes, double min_time, Run run) {
+    using clock = std::chrono::steady_clock;
+    run(); // warm-up, the first pass pays for page faults
+    long iterations = 0, batch = 1;
+    const auto start = clock::now();
+    double seconds = 0.0;
+    while (seconds < min_time) {
+        for (long i = 0; i < batch; ++i) run();
+        iterations += batch;
+        seconds = std::chrono::duration<double>(clock::now() - start).count();
+        if (seconds < min_time / 10) batch *= 2;
+    }
+    return {family, benchmark, points, bytes, iterations, seconds};
+}
+
+// positive points around y = 2x^1.3, every family can take the logarithms it needs
+static std::vector<Vector2> make_points(std::size_t n) {
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> xs(0.5f, 20.0f), noise(0.9f, 1.1f);
+    std::vector<Vector2> points(n);
+    for (auto &p : points) {
+        p.x = xs(random);
+        p.y = 2.0f * std::pow(p.x, 1.3f) * noise(random);
+    }
+    return points;
+}
+
+static volatile float sink; // keeps the results of the measured calls alive
+
+/* add_point:     n points added one by one after a reset
+ * descent_step:  one iteration over the store (O(1) with --moments)
+ * current_error: the scan of the function's error kernel
+ * evaluate_at:   the function at every x, through the virtual call one point at a time
+ * evaluate_many: the same through the function's batch kernel, ln x taken from the store
+ * the scans read the two float columns they need (evaluate_many reads one and writes one),
+ * add_point reads the points
+ */
+template <class R>
+static void run_family(const char *family, const std::vector<Vector2> &points, const PointStore &data,
+                       ThreadPool &pool, bool from_moments, double min_time, std::vector<Result> &results) {
+    const std::size_t n = points.size();
+    R regression;
+    regression.pool = &pool;
+    regression.from_moments = from_moments;
+
+    results.push_back(measure(family, "add_point", n, n * sizeof(Vector2), min_time, [&] {
+        regression.reset();
+        for (const Vector2 &p : points) regression.add_point(p);
+    }));
+
+    // the descent starts at the solution so no iteration wanders into infinities
+    regression.reset();
+    regression.add_points(points.data(), n);
+    const auto solution = regression.calculated;
+    long steps = 0;
+    results.push_back(measure(family, "descent_step", n, from_moments ? 0 : 2 * n * sizeof(float), min_time, [&] {
+        if (++steps % 1024 == 0) regression.descent = solution;
+        regression.descent_step(data);
+    }));
+    sink = regression.descent.parameters()[0];
+
+    results.push_back(measure(family, "current_error", n, 2 * n * sizeof(float), min_time, [&] {
+        sink = solution.current_error(data);
+    }));
+
+    const Function &f = solution;
+    const float *x = data.columns().x;
+    results.push_back(measure(family, "evaluate_at", n, n * sizeof(float), min_time, [&] {
+        float sum = 0.0f;
+        for (std::size_t i = 0; i < n; ++i) sum += f.evaluate_at(x[i]);
+        sink = sum;
+    }));
+
+    std::vector<float> values(n);
+    results.push_back(measure(family, "evaluate_many", n, 2 * n * sizeof(float), min_time, [&] {
+        solution.evaluate_many(data.columns(), values.data());
+        sink = values[n - 1];
+    }));
+}
+
+/* the standard convergence datasets: n points of each family's own curve with noise,
+ * in screen coordinates (x in [1, 800]) where the descent learning rates are tuned
+ */
+static std::vector<Vector2> make_dataset(const std::string &family, std::size_t n) {
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> xs(1.0f, 800.0f);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    std::vector<Vector2> points(n);
+    for (auto &p : points) {
+        const float x = xs(random), e = noise(random);
+        p.x = x;
+        if (family == "linear") p.y = 0.6f * x + 120.0f + 20.0f * e;
+        else if (family == "quadratic") p.y = 0.0015f * x * x - 0.6f * x + 200.0f + 20.0f * e;
+        else if (family == "power") p.y = 3.0f * std::pow(x, 0.8f) * std::exp(0.05f * e);
+        else p.y = 20.0f * std::pow(1.004f, x) * std::exp(0.05f * e);
+    }
+    return points;
+}
+
+struct Convergence {
+    const char *family, *optimizer;
+    std::size_t points;
+    long iterations;
+    double seconds;
+    bool converged;
+    double distance; // the largest relative difference of a parameter when it stopped
+};
+
+// the largest |descent - calculated| / |calculated| over the parameters
+template <class F>
+static double distance(const F &descent, const F &calculated) {
+    double d = 0.0;
+    const auto p = descent.parameters(), q = calculated.parameters();
+    for (std::size_t i = 0; i < p.size(); ++i) {
+        const double relative = std::abs(double(p[i]) - q[i]) / std::abs(double(q[i]));
+        if (std::isnan(relative)) return relative;
+        d = std::max(d, relative);
+    }
+    return d;
+}
+
+/* steps the descent from where the regression starts it (as after a click in the window)
+ * until it is within epsilon of the solution or time_limit has passed;
+ * the clock is read every 64 steps, the distance after every step
+ */
+template <class R>
+static Convergence converge(const char *family, const std::vector<Vector2> &points, const PointStore &data,
+                            ThreadPool &pool, bool from_moments, double epsilon, double time_limit) {
+    using clock = std::chrono::steady_clock;
+    R regression;
+    regression.pool = &pool;
+    regression.from_moments = from_moments;
+    regression.add_points(points.data(), points.size());
+
+    Convergence result {family, from_moments ? "moments" : "scan", points.size(), 0, 0.0, false, 0.0};
+    const auto start = clock::now();
+    while (true) {
+        result.distance = distance(regression.descent, regression.calculated);
+        if (result.distance <= epsilon) {
+            result.converged = true;
+            break;
+        }
+        if (std::isnan(result.distance)) break; // diverged
+        if (result.iterations % 64 == 0 && std::chrono::duration<double>(clock::now() - start).count() >= time_limit) break;
+        regression.descent_step(data);
+        result.iterations += 1;
+    }
+    result.seconds = std::chrono::duration<double>(clock::now() - start).count();
+    return result;
+}
+
+static void write_json(std::FILE *out, const std::vector<Result> &results, unsigned threads, bool from_moments) {
+    std::fprintf(out, "{\n  \"kernels\": \"%s\",\n  \"threads\": %u,\n  \"moments\": %s,\n  \"results\": [\n",
+                 kernels::active().name, threads, from_moments ? "true" : "false");
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        std::fprintf(out, "    {\"family\": \"%s\", \"benchmark\": \"%s\", \"n\": %zu, \"iterations\": %ld, \"seconds\": %.6f, "
+                          "\"ns_per_point\": %.4f, \"gb_per_s\": %.4f, \"iterations_per_s\": %.2f}%s\n",
+                     r.family, r.benchmark, r.points, r.iterations, r.seconds,
+                     r.ns_per_point(), r.gb_per_second(), r.iterations_per_second(), i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
+
+static void write_json(std::FILE *out, const std::vector<Convergence> &results, unsigned threads, double epsilon) {
+    std::fprintf(out, "{\n  \"kernels\": \"%s\",\n  \"threads\": %u,\n  \"epsilon\": %g,\n  \"convergence\": [\n",
+                 kernels::active().name, threads, epsilon);
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Convergence &r = results[i];
+        std::fprintf(out, "    {\"family\": \"%s\", \"optimizer\": \"%s\", \"n\": %zu, \"converged\": %s, "
+                          "\"iterations\": %ld, \"seconds\": %.6f, \"distance\": %.6g}%s\n",
+                     r.family, r.optimizer, r.points, r.converged ? "true" : "false",
+                     r.iterations, r.seconds, r.distance, i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
+
+// opens FILE or stdout for -
+static std::FILE *open_json(const char *json) {
+    std::FILE *out = std::strcmp(json, "-") == 0 ? stdout : std::fopen(json, "w");
+    if (!out) std::fprintf(stderr, "cannot write %s\n", json);
+    return out;
+}
+
+static int run_convergence(const std::string &family, std::size_t n, ThreadPool &pool, double epsilon, double time_limit, const char *json) {
+    std::vector<Convergence> results;
+    std::fprintf(stderr, "%s kernels, %u threads, epsilon %g\n", kernels::active().name, pool.size(), epsilon);
+    std::fprintf(stderr, "%-12s %-9s %10s %10s %12s %10s %12s\n", "family", "optimizer", "n", "converged", "iterations", "seconds", "distance");
+    for (const char *name : {"linear", "quadratic", "power", "exponential"}) {
+        if (family != "all" && family != name) continue;
+        const std::vector<Vector2> points = make_dataset(name, n);
+        PointStore data;
+        data.assign(points.data(), n);
+        for (bool from_moments : {false, true}) {
+            const std::string f = name;
+            if (f == "linear") results.push_back(converge<LinearRegression>(name, points, data, pool, from_moments, epsilon, time_limit));
+            else if (f == "quadratic") results.push_back(converge<QuadraticRegression>(name, points, data, pool, from_moments, epsilon, time_limit));
+            else if (f == "power") results.push_back(converge<PowerRegression>(name, points, data, pool, from_moments, epsilon, time_limit));
+            else results.push_back(converge<ExponentialRegression>(name, points, data, pool, from_moments, epsilon, time_limit));
+            const Convergence &r = results.back();
+            std::fprintf(stderr, "%-12s %-9s %10zu %10s %12ld %10.4f %12.4g\n", r.family, r.optimizer, r.points,
+                         r.converged ? "yes" : "no", r.iterations, r.seconds, r.distance);
+        }
+    }
+    if (json) {
+        std::FILE *out = open_json(json);
+        if (!out) return 1;
+        write_json(out, results, pool.size(), epsilon);
+        if (out != stdout) std::fclose(out);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    std::size_t max_points = 10000000;
+    std::string family = "all";
+    double min_time = 0.2;
+    bool from_moments = false, convergence = false;
+    std::size_t dataset_points = 100000;
+    double epsilon = 1e-3, time_limit = 10.0;
+    unsigned threads = 0;
+    const char *json = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--max") == 0 && has_value) max_points = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--family") == 0 && has_value) family = argv[++i];
+        else if (std::strcmp(argv[i], "--min-time") == 0 && has_value) min_time = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--threads") == 0 && has_value) threads = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--json") == 0 && has_value) json = argv[++i];
+        else if (std::strcmp(argv[i], "--points") == 0 && has_value) dataset_points = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--epsilon") == 0 && has_value) epsilon = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--time-limit") == 0 && has_value) time_limit = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--moments") == 0) from_moments = true;
+        else if (std::strcmp(argv[i], "--convergence") == 0) convergence = true;
+        else { usage(); return 2; }
+    }
+    if (family != "all" && family != "linear" && family != "quadratic" && family != "power" && family != "exponential") {
+        usage();
+        return 2;
+    }
+
+    ThreadPool pool(threads ? threads : std::max(1u, std::thread::hardware_concurrency()));
+    if (convergence) return run_convergence(family, dataset_points, pool, epsilon, time_limit, json);
+
+    std::vector<Result> results;
+    std::fprintf(stderr, "%s kernels, %u threads\n", kernels::active().name, pool.size());
+    std::fprintf(stderr, "%-12s %-14s %10s %12s %10s %10s %14s\n", "family", "benchmark", "n", "iterations", "ns/point", "GB/s", "iterations/s");
+    for (std::size_t n = 10; n <= max_points; n *= 10) {
+        const std::vector<Vector2> points = make_points(n);
+        PointStore data;
+        data.assign(points.data(), n);
+        const std::size_t first = results.size();
+        if (family == "all" || family == "linear")
+            run_family<LinearRegression>("linear", points, data, pool, from_moments, min_time, results);
+        if (family == "all" || family == "quadratic")
+            run_family<QuadraticRegression>("quadratic", points, data, pool, from_moments, min_time, results);
+        if (family == "all" || family == "power")
+            run_family<PowerRegression>("power", points, data, pool, from_moments, min_time, results);
+        if (family == "all" || family == "exponential")
+            run_family<ExponentialRegression>("exponential", points, data, pool, from_moments, min_time, results);
+        for (std::size_t i = first; i < results.size(); ++i) {
+            const Result &r = results[i];
+            std::fprintf(stderr, "%-12s %-14s %10zu %12ld %10.3f %10.3f %14.1f\n", r.family, r.benchmark, r.points,
+                         r.iterations, r.ns_per_point(), r.gb_per_second(), r.iterations_per_second());
+        }
+    }
+
+    if (json) {
+        std::FILE *out = open_json(json);
+        if (!out) return 1;
+        write_json(out, results, pool.size(), from_moments);
+        if (out != stdout) std::fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+#include "vector2.hpp"
+
+/* datasets read straight out of a memory mapping
+ *
+ * .bin files are raw pairs of native floats (x0 y0 x1 y1 ...), the mapping is already an array of
+ * points and is handed on without a copy; anything else is csv-like text: one point per line,
+ * x and y separated by a comma, semicolon, tab or spaces, lines that aren't two numbers (a header) are skipped
+ */
+namespace dataset {
+
+struct Report {
+    std::size_t points = 0, skipped = 0, bytes = 0;
+    double seconds = 0.0;
+    bool ok = false;
+    double megabytes_per_second() const { return seconds > 0.0 ? bytes / seconds / 1e6 : 0.0; }
+};
+
+inline bool is_separator(char c) {
+    return c == ',' || c == ';' || c == ' ' || c == '\t';
+}
+
+/* a number at p, the end of it or nullptr
+ * plain decimals with up to 15 digits, the usual csv case, are converted in one division
+ * of exact doubles (then rounded to float); exponents, longer numbers, inf and nan go to from_chars
+ */
+inline const char *parse_float(const char *p, const char *end, float &value) {
+    static constexpr double powers[] {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    if (p < end && *p == '+') ++p; // from_chars takes no explicit plus
+    const char *start = p;
+    const bool negative = p < end && *p == '-';
+    if (negative) ++p;
+    std::uint64_t mantissa = 0;
+    int digits = 0, scale = 0;
+    for (; p < end && (unsigned) (*p - '0') < 10; ++p, ++digits) mantissa = mantissa * 10 + (*p - '0');
+    if (p < end && *p == '.') {
+        for (++p; p < end && (unsigned) (*p - '0') < 10; ++p, ++digits, ++scale) mantissa = mantissa * 10 + (*p - '0');
+    }
+    if (digits == 0 || digits > 15 || (p < end && (*p == 'e' || *p == 'E'))) {
+        auto [number_end, error] = std::from_chars(start, end, value);
+        return error == std::errc() ? number_end : nullptr;
+    }
+    const double v = mantissa / powers[scale]; // exact operands, one rounding
+    value = negative ? -v : v;
+    return p;
+}
+
+// one "x<sep>y" line of [p, end) without its newline
+inline bool parse_line(const char *p, const char *end, Vector2 &point) {
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    p = parse_float(p, end, point.x);
+    if (!p || p == end || !is_separator(*p)) return false;
+    while (p < end && is_separator(*p)) ++p;
+    p = parse_float(p, end, point.y);
+    if (!p) return false;
+    for (; p < end; ++p) {
+        if (!is_separator(*p) && *p != '\r') return false;
+    }
+    return true;
+}
+
+// every line of [begin, end), lines are found with memchr
+inline void parse_lines(const char *begin, const char *end, std::vector<Vector2> &points, std::size_t &skipped) {
+    while (begin < end) {
+        const char *eol = static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+        if (!eol) eol = end;
+        Vector2 point;
+        if (parse_line(begin, eol, point)) {
+            points.push_back(point);
+        } else if (eol > begin && !(eol - begin == 1 && *begin == '\r')) {
+            skipped += 1;
+        }
+        begin = eol + 1;
+    }
+}
+
+/* the text is cut into one piece per pool thread at line boundaries,
+ * the pieces are parsed independently and joined in file order
+ */
+inline std::vector<Vector2> parse_csv(ThreadPool *pool, const char *text, std::size_t size, std::size_t &skipped) {
+    constexpr std::size_t min_piece = 1 << 20;
+    const std::size_t pieces = pool ? std::max<std::size_t>(1, std::min<std::size_t>(pool->size(), size / min_piece)) : 1;
+    std::vector<const char *> cuts {text};
+    for (std::size_t i = 1; i < pieces; ++i) {
+        const char *guess = std::max(cuts.back(), text + size * i / pieces);
+        const char *eol = static_cast<const char *>(std::memchr(guess, '\n', text + size - guess));
+        cuts.push_back(eol ? eol + 1 : text + size);
+    }
+    cuts.push_back(text + size);
+
+    std::vector<std::vector<Vector2>> parsed(pieces);
+    std::vector<std::size_t> skips(pieces, 0);
+    auto parse = [&](std::size_t i) {
+        parsed[i].reserve((cuts[i + 1] - cuts[i]) / 12); // a guess at the shortest usual line
+        parse_lines(cuts[i], cuts[i + 1], parsed[i], skips[i]);
+    };
+    if (pieces == 1) parse(0); else pool->run(pieces, parse);
+
+    if (pieces == 1) {
+        skipped += skips[0];
+        return std::move(parsed[0]);
+    }
+    std::size_t total = 0;
+    for (const auto &piece : parsed) total += piece.size();
+    std::vector<Vector2> points;
+    points.reserve(total);
+    for (std::size_t i = 0; i < pieces; ++i) {
+        points.insert(points.end(), parsed[i].begin(), parsed[i].end());
+        skipped += skips[i];
+    }
+    return points;
+}
+
+inline bool is_binary(const char *path) {
+    const std::size_t length = std::strlen(path);
+    return length >= 4 && std::strcmp(path + length - 4, ".bin") == 0;
+}
+
+/* maps the file, parses it and calls feed(points, count) once with every point;
+ * the time reported covers all of it, feeding included
+ * a file without a single point (not a dataset at all, e.g. a picture) fails and feed isn't called,
+ * so the caller's points stay as they were
+ */
+template <class Feed>
+inline Report load(const char *path, ThreadPool *pool, Feed feed) {
+    Report report;
+    const auto start = std::chrono::steady_clock::now();
+    const MappedFile file(path);
+    if (!file) return report;
+    report.bytes = file.size();
+    if (is_binary(path)) {
+        report.points = file.size() / sizeof(Vector2);
+        report.skipped = file.size() % sizeof(Vector2) != 0; // a torn last pair
+        if (report.points > 0) feed(reinterpret_cast<const Vector2 *>(file.data()), report.points);
+    } else {
+        const std::vector<Vector2> points = parse_csv(pool, file.data(), file.size(), report.skipped);
+        report.points = points.size();
+        if (report.points > 0) feed(points.data(), points.size());
+    }
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report.ok = report.points > 0;
+    return report;
+}
+
+} // namespace dataset
@@ -0,0 +1,168 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <raylib.h>
+#include "functions.hpp"
+
+/* everything that puts functions and regressions on the screen,
+ * kept apart from the numeric headers so those build without raylib
+ */
+
+extern const int screen_width, screen_height;
+
+// the visible part of a curve as connected strips of screen vertices
+struct Strips {
+    std::vector<Vector2> vertices;
+    std::vector<std::pair<int, int>> runs; // first vertex and vertex count of each strip
+
+    void clear() {
+        vertices.clear();
+        runs.clear();
+    }
+
+    void draw(Color color) {
+        for (const auto &[start, count] : runs) DrawLineStrip(vertices.data() + start, count, color);
+    }
+};
+
+// where f turns between rising and falling, if anywhere; the other families are monotone for x > 0
+inline std::optional<float> turning_point(const LinearFunction &) { return std::nullopt; }
+inline std::optional<float> turning_point(const PowerFunction &) { return std::nullopt; }
+inline std::optional<float> turning_point(const ExponentialFunction &) { return std::nullopt; }
+inline std::optional<float> turning_point(const QuadraticFunction &f) {
+    if (f.a == 0.0f) return std::nullopt;
+    return -f.b / (2 * f.a);
+}
+
+/* y = f(x) for 0 <= x <= screen_width as line strips, with as few vertices as the shape needs
+ *
+ * the width is cut into a few spans, also at f's turning point so that f is monotone on each,
+ * and spans are halved while f at the middle of a span is more than a quarter pixel off its chord;
+ * y is clamped to just beyond the screen for that test, so stretches far outside count as flat
+ * and cost nothing (monotone, a span with both ends beyond one edge is beyond it all the way),
+ * and spans are never halved below an eighth of a pixel
+ * segments are clipped where f itself crosses the top or bottom edge (found by bisection),
+ * so steep curves near an asymptote end on the border and not at the last sample
+ */
+template <class F>
+struct Tessellator {
+    static constexpr int spans = 8;
+    static constexpr float tolerance = 0.25f, min_step = 0.125f;
+
+    static void run(const F &f, Strips &out) {
+        out.clear();
+        Tessellator t {f, out};
+        float xs[spans + 2];
+        int count = 0;
+        for (int i = 0; i <= spans; ++i) xs[count++] = (float) screen_width * i / spans;
+        const std::optional<float> turn = turning_point(f);
+        if (turn && 0.0f < *turn && *turn < screen_width) {
+            xs[count++] = *turn;
+            std::sort(xs, xs + count);
+        }
+        float ya = f.evaluate_at(xs[0]);
+        for (int i = 1; i < count; ++i) {
+            const float yb = f.evaluate_at(xs[i]);
+            if (xs[i] > xs[i - 1]) t.span(xs[i - 1], ya, xs[i], yb);
+            ya = yb;
+        }
+    }
+
+    const F &f;
+    Strips &out;
+
+    private:
+        static float clamped(float y) { return std::clamp(y, -1.0f, screen_height + 1.0f); }
+        // -1 below the screen, 1 above it, 0 on it
+        static int side(float y) { return y < 0 ? -1 : y > screen_height ? 1 : 0; }
+
+        void span(float xa, float ya, float xb, float yb) {
+            const float xm = 0.5f * (xa + xb), ym = f.evaluate_at(xm);
+            const float off = std::abs(clamped(ym) - 0.5f * (clamped(ya) + clamped(yb)));
+            if (xb - xa > min_step && !(off <= tolerance)) { // nan is halved down to the smallest span
+                span(xa, ya, xm, ym);
+                span(xm, ym, xb, yb);
+            } else {
+                segment(xa, ya, xb, yb);
+            }
+        }
+
+        void segment(float xa, float ya, float xb, float yb) {
+            if (std::isnan(ya) || std::isnan(yb)) return;
+            const int sa = side(ya), sb = side(yb);
+            if (sa != 0 && sa == sb) return;
+            Vector2 a = vertex(xa, ya), b = vertex(xb, yb);
+            if (sa != 0) a = vertex(crossing(xa, ya, xb, edge(sa)), edge(sa));
+            if (sb != 0) b = vertex(crossing(xb, yb, xa, edge(sb)), edge(sb));
+            const bool joined = !out.runs.empty() && out.vertices.back().x == a.x && out.vertices.back().y == a.y;
+            if (!joined) {
+                out.runs.push_back({(int) out.vertices.size(), 0});
+                out.vertices.push_back(a);
+            }
+            out.vertices.push_back(b);
+            out.runs.back().second = out.vertices.size() - out.runs.back().first;
+        }
+
+        static float edge(int side) { return side < 0 ? 0.0f : (float) screen_height; }
+        static Vector2 vertex(float x, float y) { return {x, screen_height - y}; }
+
+        // where f crosses y = edge between x_out (where f is beyond it) and x_in
+        float crossing(float x_out, float y_out, float x_in, float edge) const {
+            const bool out_below = y_out < edge;
+            for (int i = 0; i < 24; ++i) {
+                const float xm = 0.5f * (x_out + x_in);
+                if ((f.evaluate_at(xm) < edge) == out_below) x_out = xm; else x_in = xm;
+            }
+            return 0.5f * (x_out + x_in);
+        }
+};
+
+/* a curve's strips, tessellated again only when the function's parameters change,
+ * so a curve that stays put (converged, or the closed form between new points) costs a few DrawLineStrip calls
+ */
+template <class F>
+struct CachedCurve {
+    void plot(const F &f, Color color) {
+        if (!built || f.parameters() != parameters) {
+            Tessellator<F>::run(f, strips);
+            parameters = f.parameters();
+            built = true;
+        }
+        strips.draw(color);
+    }
+
+    private:
+        typename F::Parameters parameters;
+        bool built = false;
+        Strips strips;
+};
+
+// the two curves of a regression: the closed form and the descent
+template <class F>
+struct RegressionCurves {
+    CachedCurve<F> calculated, descent;
+};
+
+// the title and the formula, e.g. of a descent state published by a solver thread
+inline void draw_description(const LinearFunction &f, int x, int y, int font_size, Color color) {
+    DrawText("Linear regression", x, y, font_size, color);
+    DrawText(TextFormat("y = %.4fx + %.4f", f.a, f.b), x, font_size + y, font_size, color);
+}
+
+inline void draw_description(const QuadraticFunction &f, int x, int y, int font_size, Color color) {
+    DrawText("Quadratic regression", x, y, font_size, color);
+    DrawText(TextFormat("y = %.4f^2 + %.4fx + %.4f", f.a, f.b, f.c), x, font_size + y, font_size, color);
+}
+
+inline void draw_description(const PowerFunction &f, int x, int y, int font_size, Color color) {
+    DrawText("Power regression", x, y, font_size, color);
+    DrawText(TextFormat("y = %.4f * x^%.4f", f.a, f.b), x, font_size + y, font_size, color);
+}
+
+inline void draw_description(const ExponentialFunction &f, int x, int y, int font_size, Color color) {
+    DrawText("Exponential regression", x, y, font_size, color);
+    DrawText(TextFormat("y = %.4f * %.4f^x", f.a, f.b), x, font_size + y, font_size, color);
+}
@@ -1,24 +1,16 @@
 #pragma once
-#include <raylib.h>
 #include <vector>
 #include <cmath>
-
-extern const int screen_width, screen_height;
+#include <array>
+#include "point_store.hpp"
 
 struct Function {
-    virtual float evaluate_at(float x) = 0;
-    void plot(Color color) {
-        float prev = evaluate_at(0);
-        for (int x = 1; x < screen_width; ++x) {
-            float cur = evaluate_at(x);
-            if (0 < cur && cur < screen_height || 0 < prev && prev < screen_height) {
-                DrawLine(x - 1, screen_height - prev, x, screen_height - cur, color);
-            }
-            prev = cur;
-
-        }
+    virtual float evaluate_at(float x) const = 0;
+    // out[i] = f(xs[i]) for i in [0, n)
+    virtual void evaluate_many(const float *xs, float *out, std::size_t n) const {
+        for (std::size_t i = 0; i < n; ++i) out[i] = evaluate_at(xs[i]);
     }
-    float current_error(std::vector<Vector2> &data) {
+    float current_error(const PointStore &data) const {
         float e = 0.0f;
         for (auto [x, y] : data) {
             e += std::pow(evaluate_at(x) - y, 2);
@@ -27,41 +19,85 @@ struct Function {
     }
 };
 
-struct LinearFunction : Function {
-
-    //draws y = ax + b through the entire screen
-    static void draw_line(float a, float b, Color color) {
-        DrawLine(0, screen_height - (a * 0 + b), screen_width, screen_height - (a * screen_width + b), color);
-    }
-    //small optimization
-    void plot(Color color) {
-        for (int x = 0; x < screen_width; ++x) {
-            DrawPixel(x, screen_height - evaluate_at(x), color);
-        }
+/* the loops over many x written against the concrete function F (which is final),
+ * so they end up in F's values kernel without a virtual call per point,
+ * while the functions stay usable through Function & one point at a time
+ */
+template <class F>
+struct StaticFunction : Function {
+    void evaluate_many(const float *xs, float *out, std::size_t n) const override {
+        evaluate_many(kernels::Columns {xs, nullptr, nullptr, nullptr, nullptr, n}, out);
+    }
+    // out[i] = f(cols.x[i]), with the derived columns of cols (ln x) used when they are there
+    void evaluate_many(const kernels::Columns &cols, float *out) const {
+        static_cast<const F &>(*this).values(cols, out);
     }
-    float evaluate_at(float x) {
+};
+
+struct LinearFunction final : StaticFunction<LinearFunction> {
+    float evaluate_at(float x) const override {
         return a * x + b;
     }
+    void values(const kernels::Columns &cols, float *out) const {
+        kernels::active().linear_values(cols, a, b, out);
+    }
+    float current_error(const PointStore &data) const {
+        const double e = kernels::active().linear_error(data.columns(), a, b);
+        return data.size() > 0 ? e / data.size() : e;
+    }
+    using Parameters = std::array<float, 2>;
+    Parameters parameters() const { return {a, b}; }
+    void set_parameters(const Parameters &p) { a = p[0]; b = p[1]; }
     float a = 0.0f, b = 0.0f;
 };
 
-struct QuadraticFunction : Function {
-    float evaluate_at(float x) {
+struct QuadraticFunction final : StaticFunction<QuadraticFunction> {
+    float evaluate_at(float x) const override {
         return a * std::pow(x, 2) + b * x + c;
     }
+    void values(const kernels::Columns &cols, float *out) const {
+        kernels::active().quadratic_values(cols, a, b, c, out);
+    }
+    float current_error(const PointStore &data) const {
+        const double e = kernels::active().quadratic_error(data.columns(), a, b, c);
+        return data.size() > 0 ? e / data.size() : e;
+    }
+    using Parameters = std::array<float, 3>;
+    Parameters parameters() const { return {a, b, c}; }
+    void set_parameters(const Parameters &p) { a = p[0]; b = p[1]; c = p[2]; }
     float a = 0.0f, b = 0.0f, c = 0.0f;
 };
 
-struct PowerFunction : Function {
-    float evaluate_at(float x) {
+struct PowerFunction final : StaticFunction<PowerFunction> {
+    float evaluate_at(float x) const override {
         return a * std::pow(x, b);
     }
+    void values(const kernels::Columns &cols, float *out) const {
+        kernels::active().power_values(cols, a, b, out);
+    }
+    float current_error(const PointStore &data) const {
+        const double e = kernels::active().power_error(data.columns(), a, b);
+        return data.size() > 0 ? e / data.size() : e;
+    }
+    using Parameters = std::array<float, 2>;
+    Parameters parameters() const { return {a, b}; }
+    void set_parameters(const Parameters &p) { a = p[0]; b = p[1]; }
     float a = 0.0f, b = 0.0f;
 };
 
-struct ExponentialFunction : Function {
-    float evaluate_at(float x) {
+struct ExponentialFunction final : StaticFunction<ExponentialFunction> {
+    float evaluate_at(float x) const override {
         return a * std::pow(b, x);
     }
+    void values(const kernels::Columns &cols, float *out) const {
+        kernels::active().exponential_values(cols, a, b, out);
+    }
+    float current_error(const PointStore &data) const {
+        const double e = kernels::active().exponential_error(data.columns(), a, b);
+        return data.size() > 0 ? e / data.size() : e;
+    }
+    using Parameters = std::array<float, 2>;
+    Parameters parameters() const { return {a, b}; }
+    void set_parameters(const Parameters &p) { a = p[0]; b = p[1]; }
     float a = 0.0f, b = 0.0f;
 };
@@ -0,0 +1,130 @@
+// the fitting without a window, for servers and scripts:
+// g++ -std=c++17 -O2 headless.cpp -pthread -o headless
+#define HEADLESS
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include "point_store.hpp"
+#include "regressions.hpp"
+#include "snapshot.hpp"
+#include "dataset.hpp"
+
+static void usage() {
+    std::fprintf(stderr,
+        "usage: headless [options] [file...]\n"
+        "  file                points as csv, raw float pairs (.bin) or a session snapshot; none reads csv from stdin\n"
+        "  --family NAME       linear, quadratic, power, exponential or all (default all)\n"
+        "  --iterations N      gradient descent iterations after the closed-form fit (default 0)\n"
+        "  --moments           take the descent gradient from the running sums\n"
+        "  --threads N         threads for bulk loading and the scans (default all cores)\n");
+}
+
+// one line per fit: the closed form with its scores, then where the descent got to
+template <class R>
+static void report(const char *name, R &regression, const PointStore &data, long iterations) {
+    const Regression::Score score = regression.score();
+    std::printf("%-12s closed  ", name);
+    for (float p : regression.calculated.parameters()) std::printf(" %.9g", p);
+    std::printf("  error %.9g", regression.current_error(regression.calculated, data));
+    if (score.valid) std::printf("  r2 %.6f  aic %.6g  bic %.6g", score.r2, score.aic, score.bic);
+    std::printf("\n");
+    if (iterations <= 0) return;
+    for (long i = 0; i < iterations; ++i) regression.descent_step(data);
+    std::printf("%-12s descent ", name);
+    for (float p : regression.descent.parameters()) std::printf(" %.9g", p);
+    std::printf("  error %.9g  after %ld iterations\n", regression.current_error(regression.descent, data), iterations);
+}
+
+int main(int argc, char **argv) {
+    std::string family = "all";
+    long iterations = 0;
+    bool from_moments = false;
+    unsigned threads = 0;
+    std::vector<const char *> files;
+    for (int i = 1; i < argc; ++i) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--family") == 0 && has_value) family = argv[++i];
+        else if (std::strcmp(argv[i], "--iterations") == 0 && has_value) iterations = std::atol(argv[++i]);
+        else if (std::strcmp(argv[i], "--threads") == 0 && has_value) threads = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--moments") == 0) from_moments = true;
+        else if (argv[i][0] == '-' && argv[i][1] != '\0') { usage(); return 2; }
+        else files.push_back(argv[i]);
+    }
+    if (family != "all" && family != "linear" && family != "quadratic" && family != "power" && family != "exponential") {
+        usage();
+        return 2;
+    }
+
+    ThreadPool pool(threads ? threads : std::max(1u, std::thread::hardware_concurrency()));
+    PointStore data;
+    LinearRegression lr;
+    QuadraticRegression qr;
+    PowerRegression pr;
+    ExponentialRegression er;
+    Regression *regressions[] { &lr, &qr, &pr, &er };
+
+    for (auto regression: regressions) {
+        regression->from_moments = from_moments;
+        regression->pool = &pool;
+    }
+
+    // a snapshot given first restores its session, descent state included; datasets add their points on top
+    bool restored = false;
+    std::vector<Vector2> points;
+    auto feed = [&](const Vector2 *p, std::size_t count) { points.insert(points.end(), p, p + count); };
+    for (const char *path : files) {
+        if (!restored && points.empty() && snapshot::load(path, data, {lr, qr, pr, er})) {
+            restored = true;
+            continue;
+        }
+        const dataset::Report loaded = dataset::load(path, &pool, feed);
+        if (!loaded.ok) {
+            std::fprintf(stderr, "cannot read %s\n", path);
+            return 1;
+        }
+        std::fprintf(stderr, "%s: %zu points, %zu lines skipped, %.1f MB/s\n",
+                     path, loaded.points, loaded.skipped, loaded.megabytes_per_second());
+    }
+    if (files.empty()) {
+        std::string text;
+        char buffer[1 << 16];
+        for (ssize_t got; (got = ::read(STDIN_FILENO, buffer, sizeof(buffer))) > 0;) text.append(buffer, got);
+        std::size_t skipped = 0;
+        points = dataset::parse_csv(&pool, text.data(), text.size(), skipped);
+    }
+
+    if (!points.empty()) {
+        std::vector<Vector2> all;
+        all.reserve(data.size() + points.size());
+        for (auto point : data) all.push_back(point);
+        all.insert(all.end(), points.begin(), points.end());
+        data.assign(all.data(), all.size());
+        if (data.size() == all.size()) {
+            add_points(lr, &pool, points.data(), points.size());
+            add_points(qr, &pool, points.data(), points.size());
+            add_points(pr, &pool, points.data(), points.size());
+            add_points(er, &pool, points.data(), points.size());
+        } else {
+            // a restored window pushed points out, the sums start over from the ones it kept
+            const Vector2 *kept = all.data() + all.size() - data.size();
+            for (auto regression : regressions) regression->forget_points();
+            add_points(lr, &pool, kept, data.size());
+            add_points(qr, &pool, kept, data.size());
+            add_points(pr, &pool, kept, data.size());
+            add_points(er, &pool, kept, data.size());
+        }
+    }
+    if (data.empty()) {
+        std::fprintf(stderr, "no points\n");
+        return 1;
+    }
+
+    std::printf("%zu points, %s kernels\n", data.size(), kernels::active().name);
+    if (family == "all" || family == "linear") report("linear", lr, data, iterations);
+    if (family == "all" || family == "quadratic") report("quadratic", qr, data, iterations);
+    if (family == "all" || family == "power") report("power", pr, data, iterations);
+    if (family == "all" || family == "exponential") report("exponential", er, data, iterations);
+    return 0;
+}
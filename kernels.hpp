@@ -0,0 +1,385 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include "thread_pool.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+/* single-pass reductions over the columns of a point store
+ * behind a table of function pointers chosen once for the running CPU
+ *
+ * gradient kernels write the sums the partial derivatives are made of:
+ * out[0] = sum r, out[1] = sum r * u, out[2] = sum r * x^2 (quadratic only),
+ * where r is the residual of the point and u is x (ln x for the power regression)
+ * the rest are maps: log fills out[i] = ln in[i] for bulk loading,
+ * the values kernels fill out[i] = f(x[i]) for drawing (y is not read, it may be null)
+ */
+namespace kernels {
+
+// derived columns are optional, kernels compute them on the fly when they are null
+struct Columns {
+    const float *x, *y;
+    const float *x2, *lnx, *lny;
+    std::size_t n;
+};
+
+// points [begin, end) of the columns
+inline Columns slice(const Columns &cols, std::size_t begin, std::size_t end) {
+    auto offset = [begin](const float *column) { return column ? column + begin : nullptr; };
+    return {cols.x + begin, offset(cols.y), offset(cols.x2), offset(cols.lnx), offset(cols.lny), end - begin};
+}
+
+struct Table {
+    const char *name;
+    void (*linear_gradient)(const Columns &cols, float a, float b, double out[2]);
+    void (*quadratic_gradient)(const Columns &cols, float a, float b, float c, double out[3]);
+    void (*power_gradient)(const Columns &cols, float lna, float b, double out[2]);
+    void (*exponential_gradient)(const Columns &cols, float lna, float lnb, double out[2]);
+    double (*linear_error)(const Columns &cols, float a, float b);           // sum (f(x) - y)^2
+    double (*quadratic_error)(const Columns &cols, float a, float b, float c);
+    double (*power_error)(const Columns &cols, float a, float b);
+    double (*exponential_error)(const Columns &cols, float a, float b);
+    void (*log)(const float *in, float *out, std::size_t n);
+    void (*linear_values)(const Columns &cols, float a, float b, float *out);
+    void (*quadratic_values)(const Columns &cols, float a, float b, float c, float *out);
+    void (*power_values)(const Columns &cols, float a, float b, float *out);
+    void (*exponential_values)(const Columns &cols, float a, float b, float *out);
+};
+
+// reference implementations, also used for the tails of the vectorized ones
+namespace scalar {
+
+inline void linear_gradient(const Columns &cols, float a, float b, double out[2]) {
+    double s_r = 0.0, s_rx = 0.0;
+    for (std::size_t i = 0; i < cols.n; ++i) {
+        const float x = cols.x[i];
+        const float r = a * x + b - cols.y[i];
+        s_r += r;
+        s_rx += r * x;
+    }
+    out[0] = s_r;
+    out[1] = s_rx;
+}
+
+inline void quadratic_gradient(const Columns &cols, float a, float b, float c, double out[3]) {
+    double s_r = 0.0, s_rx = 0.0, s_rx2 = 0.0;
+    for (std::size_t i = 0; i < cols.n; ++i) {
+        const float x = cols.x[i];
+        const float x2 = cols.x2 ? cols.x2[i] : x * x;
+        const float r = a * x2 + b * x + c - cols.y[i];
+        s_r += r;
+        s_rx += r * x;
+        s_rx2 += r * x2;
+    }
+    out[0] = s_r;
+    out[1] = s_rx;
+    out[2] = s_rx2;
+}
+
+inline void power_gradient(const Columns &cols, float lna, float b, double out[2]) {
+    double s_r = 0.0, s_rlnx = 0.0;
+    for (std::size_t i = 0; i < cols.n; ++i) {
+        const float lnx = cols.lnx ? cols.lnx[i] : std::log(cols.x[i]);
+        const float lny = cols.lny ? cols.lny[i] : std::log(cols.y[i]);
+        const float r = b * lnx + lna - lny;
+        s_r += r;
+        s_rlnx += r * lnx;
+    }
+    out[0] = s_r;
+    out[1] = s_rlnx;
+}
+
+inline void exponential_gradient(const Columns &cols, float lna, float lnb, double out[2]) {
+    double s_r = 0.0, s_rx = 0.0;
+    for (std::size_t i = 0; i < cols.n; ++i) {
+        const float x = cols.x[i];
+        const float lny = cols.lny ? cols.lny[i] : std::log(cols.y[i]);
+        const float r = lna + lnb * x - lny;
+        s_r += r;
+        s_rx += r * x;
+    }
+    out[0] = s_r;
+    out[1] = s_rx;
+}
+
+inline double linear_error(const Columns &cols, float a, float b) {
+    double e = 0.0;
+    for (std::size_t i = 0; i < cols.n; ++i) {
+        e += std::pow(a * cols.x[i] + b - cols.y[i], 2);
+    }
+    return e;
+}
+
+inline double quadratic_error(const Columns &cols, float a, float b, float c) {
+    double e = 0.0;
+    for (std::size_t i = 0; i < cols.n; ++i) {
+        e += std::pow(a * std::pow(cols.x[i], 2) + b * cols.x[i] + c - cols.y[i], 2);
+    }
+    return e;
+}
+
+inline double power_error(const Columns &cols, float a, float b) {
+    double e = 0.0;
+    for (std::size_t i = 0; i < cols.n; ++i) {
+        e += std::pow(a * std::pow(cols.x[i], b) - cols.y[i], 2);
+    }
+    return e;
+}
+
+inline double exponential_error(const Columns &cols, float a, float b) {
+    double e = 0.0;
+    for (std::size_t i = 0; i < cols.n; ++i) {
+        e += std::pow(a * std::pow(b, cols.x[i]) - cols.y[i], 2);
+    }
+    return e;
+}
+
+inline void log(const float *in, float *out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        out[i] = std::log(in[i]);
+    }
+}
+
+inline void linear_values(const Columns &cols, float a, float b, float *out) {
+    for (std::size_t i = 0; i < cols.n; ++i) {
+        out[i] = a * cols.x[i] + b;
+    }
+}
+
+inline void quadratic_values(const Columns &cols, float a, float b, float c, float *out) {
+    for (std::size_t i = 0; i < cols.n; ++i) {
+        out[i] = (a * cols.x[i] + b) * cols.x[i] + c;
+    }
+}
+
+inline void power_values(const Columns &cols, float a, float b, float *out) {
+    for (std::size_t i = 0; i < cols.n; ++i) {
+        const float lnx = cols.lnx ? cols.lnx[i] : std::log(cols.x[i]);
+        out[i] = a * std::exp(b * lnx);
+    }
+}
+
+inline void exponential_values(const Columns &cols, float a, float b, float *out) {
+    const float lnb = std::log(b);
+    for (std::size_t i = 0; i < cols.n; ++i) {
+        out[i] = a * std::exp(cols.x[i] * lnb);
+    }
+}
+
+inline const Table table {
+    "scalar",
+    linear_gradient, quadratic_gradient, power_gradient, exponential_gradient,
+    linear_error, quadratic_error, power_error, exponential_error,
+    log,
+    linear_values, quadratic_values, power_values, exponential_values
+};
+
+} // namespace scalar
+
+#ifdef KERNELS_X86
+
+/* every instruction set gets a thin wrapper V over its vector type,
+ * then kernels.inl is compiled against it with the matching target enabled
+ */
+
+namespace sse2 {
+#pragma GCC push_options
+#pragma GCC target("sse2")
+struct V {
+    using T = __m128;
+    using M = __m128;
+    static constexpr const char *name = "sse2";
+    static constexpr std::size_t width = 4;
+    static T set1(float x) { return _mm_set1_ps(x); }
+    static T bits(unsigned x) { return _mm_castsi128_ps(_mm_set1_epi32(x)); }
+    static T load(const float *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, T x) { _mm_storeu_ps(p, x); }
+    static T add(T a, T b) { return _mm_add_ps(a, b); }
+    static T sub(T a, T b) { return _mm_sub_ps(a, b); }
+    static T mul(T a, T b) { return _mm_mul_ps(a, b); }
+    static T fmadd(T a, T b, T c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static T min(T a, T b) { return _mm_min_ps(a, b); }
+    static T max(T a, T b) { return _mm_max_ps(a, b); }
+    static T bit_and(T a, T b) { return _mm_and_ps(a, b); }
+    static T bit_or(T a, T b) { return _mm_or_ps(a, b); }
+    static M lt(T a, T b) { return _mm_cmplt_ps(a, b); }
+    static M eq(T a, T b) { return _mm_cmpeq_ps(a, b); }
+    static T select(M m, T a, T b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+    static T floor(T x) {
+        const T t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+        return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0f)));
+    }
+    static T exponent(T x) { // unbiased exponent of x as float
+        return _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(x), 23), _mm_set1_epi32(0x7f)));
+    }
+    static T pow2(T n) { // 2^n for integral n
+        return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(0x7f)), 23));
+    }
+    static double reduce(T x) {
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, x);
+        return (double) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+};
+#include "kernels.inl"
+#pragma GCC pop_options
+} // namespace sse2
+
+namespace avx2 {
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+struct V {
+    using T = __m256;
+    using M = __m256;
+    static constexpr const char *name = "avx2";
+    static constexpr std::size_t width = 8;
+    static T set1(float x) { return _mm256_set1_ps(x); }
+    static T bits(unsigned x) { return _mm256_castsi256_ps(_mm256_set1_epi32(x)); }
+    static T load(const float *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, T x) { _mm256_storeu_ps(p, x); }
+    static T add(T a, T b) { return _mm256_add_ps(a, b); }
+    static T sub(T a, T b) { return _mm256_sub_ps(a, b); }
+    static T mul(T a, T b) { return _mm256_mul_ps(a, b); }
+    static T fmadd(T a, T b, T c) { return _mm256_fmadd_ps(a, b, c); }
+    static T min(T a, T b) { return _mm256_min_ps(a, b); }
+    static T max(T a, T b) { return _mm256_max_ps(a, b); }
+    static T bit_and(T a, T b) { return _mm256_and_ps(a, b); }
+    static T bit_or(T a, T b) { return _mm256_or_ps(a, b); }
+    static M lt(T a, T b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static M eq(T a, T b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    static T select(M m, T a, T b) { return _mm256_blendv_ps(b, a, m); }
+    static T floor(T x) { return _mm256_floor_ps(x); }
+    static T exponent(T x) {
+        return _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(x), 23), _mm256_set1_epi32(0x7f)));
+    }
+    static T pow2(T n) {
+        return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(0x7f)), 23));
+    }
+    static double reduce(T x) {
+        const __m128 s = _mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, s);
+        return (double) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+};
+#include "kernels.inl"
+#pragma GCC pop_options
+} // namespace avx2
+
+namespace avx512 {
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized" // _mm512_undefined_ps in gcc's own headers
+struct V {
+    using T = __m512;
+    using M = __mmask16;
+    static constexpr const char *name = "avx512";
+    static constexpr std::size_t width = 16;
+    static T set1(float x) { return _mm512_set1_ps(x); }
+    static T bits(unsigned x) { return _mm512_castsi512_ps(_mm512_set1_epi32(x)); }
+    static T load(const float *p) { return _mm512_loadu_ps(p); }
+    static void store(float *p, T x) { _mm512_storeu_ps(p, x); }
+    static T add(T a, T b) { return _mm512_add_ps(a, b); }
+    static T sub(T a, T b) { return _mm512_sub_ps(a, b); }
+    static T mul(T a, T b) { return _mm512_mul_ps(a, b); }
+    static T fmadd(T a, T b, T c) { return _mm512_fmadd_ps(a, b, c); }
+    static T min(T a, T b) { return _mm512_min_ps(a, b); }
+    static T max(T a, T b) { return _mm512_max_ps(a, b); }
+    static T bit_and(T a, T b) { return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_castps_si512(b))); }
+    static T bit_or(T a, T b) { return _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(a), _mm512_castps_si512(b))); }
+    static M lt(T a, T b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static M eq(T a, T b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+    static T select(M m, T a, T b) { return _mm512_mask_blend_ps(m, b, a); }
+    static T floor(T x) { return _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+    static T exponent(T x) {
+        return _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_srli_epi32(_mm512_castps_si512(x), 23), _mm512_set1_epi32(0x7f)));
+    }
+    static T pow2(T n) {
+        return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(_mm512_cvttps_epi32(n), _mm512_set1_epi32(0x7f)), 23));
+    }
+    static double reduce(T x) {
+        alignas(64) float lanes[16];
+        _mm512_store_ps(lanes, x);
+        double s = 0.0;
+        for (float lane : lanes) s += lane;
+        return s;
+    }
+};
+#include "kernels.inl"
+#pragma GCC diagnostic pop
+#pragma GCC pop_options
+} // namespace avx512
+
+#endif // KERNELS_X86
+
+enum class Isa { SCALAR, SSE2, AVX2, AVX512 };
+
+// nullptr when the instruction set is not available on this machine
+inline const Table *table(Isa isa) {
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    switch (isa) {
+        case Isa::SCALAR: return &scalar::table;
+        case Isa::SSE2:   return __builtin_cpu_supports("sse2") ? &sse2::table : nullptr;
+        case Isa::AVX2:   return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? &avx2::table : nullptr;
+        case Isa::AVX512: return __builtin_cpu_supports("avx512f") ? &avx512::table : nullptr;
+    }
+    return nullptr;
+#else
+    return isa == Isa::SCALAR ? &scalar::table : nullptr;
+#endif
+}
+
+inline const Table *best_table() {
+    for (Isa isa : {Isa::AVX512, Isa::AVX2, Isa::SSE2}) {
+        if (const Table *t = table(isa)) return t;
+    }
+    return &scalar::table;
+}
+
+inline const Table *current = best_table();
+
+inline const Table &active() {
+    return *current;
+}
+
+// switch every kernel to the given instruction set, false if it is not supported
+inline bool use(Isa isa) {
+    const Table *t = table(isa);
+    if (t) current = t;
+    return t != nullptr;
+}
+
+/* runs a reduction kernel over one chunk per pool thread and sums the partials in chunk order,
+ * so the result only depends on the number of threads and not on their timing
+ * chunks are whole cache lines of every column; small inputs stay on the calling thread
+ */
+template <std::size_t K, class Kernel>
+inline void reduce(ThreadPool *pool, const Columns &cols, double out[K], Kernel kernel) {
+    constexpr std::size_t line = 64 / sizeof(float);
+    constexpr std::size_t min_chunk = 1 << 14;
+    if (!pool || pool->size() == 1 || cols.n < 2 * min_chunk) {
+        kernel(cols, out);
+        return;
+    }
+    const std::size_t chunks = std::min<std::size_t>(pool->size(), cols.n / min_chunk);
+    // ceil(n / chunks) rounded up to whole lines, so the chunks cover every point
+    const std::size_t chunk = ((cols.n + chunks - 1) / chunks + line - 1) / line * line;
+    std::vector<double> partials(chunks * K, 0.0);
+    pool->run(chunks, [&](std::size_t i) {
+        const std::size_t begin = std::min(cols.n, i * chunk);
+        const std::size_t end = std::min(cols.n, begin + chunk);
+        kernel(slice(cols, begin, end), &partials[i * K]);
+    });
+    for (std::size_t k = 0; k < K; ++k) out[k] = 0.0;
+    for (std::size_t i = 0; i < chunks; ++i) {
+        for (std::size_t k = 0; k < K; ++k) out[k] += partials[i * K + k];
+    }
+}
+
+} // namespace kernels
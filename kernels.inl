@@ -0,0 +1,245 @@
+// vectorized bodies of the kernels declared in kernels.hpp
+// included once per instruction set, inside a namespace that defines the wrapper V
+
+inline V::T vlog(V::T x) { // cephes logf
+    const V::T one = V::set1(1.0f);
+    const V::M negative = V::lt(x, V::set1(0.0f));
+    const V::M zero = V::eq(x, V::set1(0.0f));
+    const V::M infinite = V::eq(x, V::set1(INFINITY));
+    const V::M number = V::eq(x, x); // false for nan
+    x = V::max(x, V::bits(0x00800000)); // no denormals
+    V::T e = V::add(V::exponent(x), one);
+    x = V::bit_or(V::bit_and(x, V::bits(~0x7f800000u)), V::set1(0.5f));
+    // mantissa is in [0.5, 1), move it to [sqrt(1/2), sqrt(2)) for the polynomial
+    const V::M small = V::lt(x, V::set1(0.707106781186547524f));
+    e = V::sub(e, V::select(small, one, V::set1(0.0f)));
+    x = V::sub(V::add(x, V::select(small, x, V::set1(0.0f))), one);
+
+    const V::T z = V::mul(x, x);
+    V::T y = V::set1(7.0376836292e-2f);
+    for (float c : {-1.1514610310e-1f, 1.1676998740e-1f, -1.2420140846e-1f, 1.4249322787e-1f,
+                    -1.6668057665e-1f, 2.0000714765e-1f, -2.4999993993e-1f, 3.3333331174e-1f}) {
+        y = V::fmadd(y, x, V::set1(c));
+    }
+    y = V::mul(V::mul(y, x), z);
+    y = V::fmadd(e, V::set1(-2.12194440e-4f), y);
+    y = V::fmadd(z, V::set1(-0.5f), y);
+    x = V::fmadd(e, V::set1(0.693359375f), V::add(x, y));
+    x = V::select(zero, V::set1(-INFINITY), x);
+    x = V::select(infinite, V::set1(INFINITY), x);
+    return V::select(number, V::select(negative, V::set1(NAN), x), V::set1(NAN));
+}
+
+inline V::T vexp(V::T x) { // cephes expf
+    const V::M overflow = V::lt(V::set1(88.7228391f), x); // ln FLT_MAX
+    const V::M number = V::eq(x, x);
+    x = V::min(V::max(x, V::set1(-88.3762626647949f)), V::set1(88.3762626647949f));
+    const V::T fx = V::floor(V::fmadd(x, V::set1(1.44269504088896341f), V::set1(0.5f)));
+    x = V::fmadd(fx, V::set1(-0.693359375f), x);
+    x = V::fmadd(fx, V::set1(2.12194440e-4f), x);
+
+    const V::T z = V::mul(x, x);
+    V::T y = V::set1(1.9875691500e-4f);
+    for (float c : {1.3981999507e-3f, 8.3334519073e-3f, 4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f}) {
+        y = V::fmadd(y, x, V::set1(c));
+    }
+    y = V::fmadd(y, z, V::add(x, V::set1(1.0f)));
+    y = V::select(overflow, V::set1(INFINITY), V::mul(y, V::pow2(fx)));
+    return V::select(number, y, V::set1(NAN));
+}
+
+// sums K per-point terms over the first vn points (a multiple of the width),
+// the float lanes are flushed into double every block to keep long sums accurate
+template <std::size_t K, class Terms>
+inline void accumulate(std::size_t vn, double out[K], Terms terms) {
+    constexpr std::size_t block = 4096;
+    for (std::size_t k = 0; k < K; ++k) out[k] = 0.0;
+    for (std::size_t start = 0; start < vn; start += block) {
+        const std::size_t end = std::min(vn, start + block);
+        V::T acc[K];
+        for (auto &a : acc) a = V::set1(0.0f);
+        for (std::size_t i = start; i < end; i += V::width) {
+            terms(i, acc);
+        }
+        for (std::size_t k = 0; k < K; ++k) out[k] += V::reduce(acc[k]);
+    }
+}
+
+template <std::size_t K>
+inline void add_tail(double out[K], const double tail[K]) {
+    for (std::size_t k = 0; k < K; ++k) out[k] += tail[k];
+}
+
+// a derived column at i, taken from the store when it is cached
+inline V::T x2_at(const Columns &cols, std::size_t i) {
+    if (cols.x2) return V::load(cols.x2 + i);
+    const V::T x = V::load(cols.x + i);
+    return V::mul(x, x);
+}
+inline V::T lnx_at(const Columns &cols, std::size_t i) {
+    return cols.lnx ? V::load(cols.lnx + i) : vlog(V::load(cols.x + i));
+}
+inline V::T lny_at(const Columns &cols, std::size_t i) {
+    return cols.lny ? V::load(cols.lny + i) : vlog(V::load(cols.y + i));
+}
+
+inline void linear_gradient(const Columns &cols, float a, float b, double out[2]) {
+    const std::size_t vn = cols.n - cols.n % V::width;
+    const V::T va = V::set1(a), vb = V::set1(b);
+    accumulate<2>(vn, out, [&](std::size_t i, V::T *acc) {
+        const V::T x = V::load(cols.x + i);
+        const V::T r = V::sub(V::fmadd(va, x, vb), V::load(cols.y + i));
+        acc[0] = V::add(acc[0], r);
+        acc[1] = V::fmadd(r, x, acc[1]);
+    });
+    double tail[2];
+    scalar::linear_gradient(slice(cols, vn, cols.n), a, b, tail);
+    add_tail<2>(out, tail);
+}
+
+inline void quadratic_gradient(const Columns &cols, float a, float b, float c, double out[3]) {
+    const std::size_t vn = cols.n - cols.n % V::width;
+    const V::T va = V::set1(a), vb = V::set1(b), vc = V::set1(c);
+    accumulate<3>(vn, out, [&](std::size_t i, V::T *acc) {
+        const V::T x = V::load(cols.x + i);
+        const V::T x2 = x2_at(cols, i);
+        const V::T r = V::sub(V::fmadd(va, x2, V::fmadd(vb, x, vc)), V::load(cols.y + i));
+        acc[0] = V::add(acc[0], r);
+        acc[1] = V::fmadd(r, x, acc[1]);
+        acc[2] = V::fmadd(r, x2, acc[2]);
+    });
+    double tail[3];
+    scalar::quadratic_gradient(slice(cols, vn, cols.n), a, b, c, tail);
+    add_tail<3>(out, tail);
+}
+
+inline void power_gradient(const Columns &cols, float lna, float b, double out[2]) {
+    const std::size_t vn = cols.n - cols.n % V::width;
+    const V::T vlna = V::set1(lna), vb = V::set1(b);
+    accumulate<2>(vn, out, [&](std::size_t i, V::T *acc) {
+        const V::T lnx = lnx_at(cols, i);
+        const V::T r = V::sub(V::fmadd(vb, lnx, vlna), lny_at(cols, i));
+        acc[0] = V::add(acc[0], r);
+        acc[1] = V::fmadd(r, lnx, acc[1]);
+    });
+    double tail[2];
+    scalar::power_gradient(slice(cols, vn, cols.n), lna, b, tail);
+    add_tail<2>(out, tail);
+}
+
+inline void exponential_gradient(const Columns &cols, float lna, float lnb, double out[2]) {
+    const std::size_t vn = cols.n - cols.n % V::width;
+    const V::T vlna = V::set1(lna), vlnb = V::set1(lnb);
+    accumulate<2>(vn, out, [&](std::size_t i, V::T *acc) {
+        const V::T x = V::load(cols.x + i);
+        const V::T r = V::sub(V::fmadd(vlnb, x, vlna), lny_at(cols, i));
+        acc[0] = V::add(acc[0], r);
+        acc[1] = V::fmadd(r, x, acc[1]);
+    });
+    double tail[2];
+    scalar::exponential_gradient(slice(cols, vn, cols.n), lna, lnb, tail);
+    add_tail<2>(out, tail);
+}
+
+inline double linear_error(const Columns &cols, float a, float b) {
+    const std::size_t vn = cols.n - cols.n % V::width;
+    const V::T va = V::set1(a), vb = V::set1(b);
+    double e;
+    accumulate<1>(vn, &e, [&](std::size_t i, V::T *acc) {
+        const V::T r = V::sub(V::fmadd(va, V::load(cols.x + i), vb), V::load(cols.y + i));
+        acc[0] = V::fmadd(r, r, acc[0]);
+    });
+    return e + scalar::linear_error(slice(cols, vn, cols.n), a, b);
+}
+
+inline double quadratic_error(const Columns &cols, float a, float b, float c) {
+    const std::size_t vn = cols.n - cols.n % V::width;
+    const V::T va = V::set1(a), vb = V::set1(b), vc = V::set1(c);
+    double e;
+    accumulate<1>(vn, &e, [&](std::size_t i, V::T *acc) {
+        const V::T x = V::load(cols.x + i);
+        const V::T r = V::sub(V::fmadd(V::fmadd(va, x, vb), x, vc), V::load(cols.y + i));
+        acc[0] = V::fmadd(r, r, acc[0]);
+    });
+    return e + scalar::quadratic_error(slice(cols, vn, cols.n), a, b, c);
+}
+
+inline double power_error(const Columns &cols, float a, float b) {
+    const std::size_t vn = cols.n - cols.n % V::width;
+    const V::T va = V::set1(a), vb = V::set1(b);
+    double e;
+    accumulate<1>(vn, &e, [&](std::size_t i, V::T *acc) {
+        // a * x^b = a * exp(b * ln x)
+        const V::T r = V::sub(V::mul(va, vexp(V::mul(vb, lnx_at(cols, i)))), V::load(cols.y + i));
+        acc[0] = V::fmadd(r, r, acc[0]);
+    });
+    return e + scalar::power_error(slice(cols, vn, cols.n), a, b);
+}
+
+inline double exponential_error(const Columns &cols, float a, float b) {
+    const std::size_t vn = cols.n - cols.n % V::width;
+    const V::T va = V::set1(a), vlnb = V::set1(std::log(b));
+    double e;
+    accumulate<1>(vn, &e, [&](std::size_t i, V::T *acc) {
+        // a * b^x = a * exp(x * ln b)
+        const V::T r = V::sub(V::mul(va, vexp(V::mul(V::load(cols.x + i), vlnb))), V::load(cols.y + i));
+        acc[0] = V::fmadd(r, r, acc[0]);
+    });
+    return e + scalar::exponential_error(slice(cols, vn, cols.n), a, b);
+}
+
+inline void log(const float *in, float *out, std::size_t n) {
+    const std::size_t vn = n - n % V::width;
+    for (std::size_t i = 0; i < vn; i += V::width) {
+        V::store(out + i, vlog(V::load(in + i)));
+    }
+    scalar::log(in + vn, out + vn, n - vn);
+}
+
+// out[i] = value(i) for the first vn points, the scalar kernel does the tail
+template <class Value>
+inline void map(std::size_t vn, float *out, Value value) {
+    for (std::size_t i = 0; i < vn; i += V::width) {
+        V::store(out + i, value(i));
+    }
+}
+
+inline void linear_values(const Columns &cols, float a, float b, float *out) {
+    const std::size_t vn = cols.n - cols.n % V::width;
+    const V::T va = V::set1(a), vb = V::set1(b);
+    map(vn, out, [&](std::size_t i) { return V::fmadd(va, V::load(cols.x + i), vb); });
+    scalar::linear_values(slice(cols, vn, cols.n), a, b, out + vn);
+}
+
+inline void quadratic_values(const Columns &cols, float a, float b, float c, float *out) {
+    const std::size_t vn = cols.n - cols.n % V::width;
+    const V::T va = V::set1(a), vb = V::set1(b), vc = V::set1(c);
+    map(vn, out, [&](std::size_t i) {
+        // Horner: (ax + b)x + c
+        const V::T x = V::load(cols.x + i);
+        return V::fmadd(V::fmadd(va, x, vb), x, vc);
+    });
+    scalar::quadratic_values(slice(cols, vn, cols.n), a, b, c, out + vn);
+}
+
+inline void power_values(const Columns &cols, float a, float b, float *out) {
+    const std::size_t vn = cols.n - cols.n % V::width;
+    const V::T va = V::set1(a), vb = V::set1(b);
+    map(vn, out, [&](std::size_t i) { return V::mul(va, vexp(V::mul(vb, lnx_at(cols, i)))); });
+    scalar::power_values(slice(cols, vn, cols.n), a, b, out + vn);
+}
+
+inline void exponential_values(const Columns &cols, float a, float b, float *out) {
+    const std::size_t vn = cols.n - cols.n % V::width;
+    const V::T va = V::set1(a), vlnb = V::set1(std::log(b));
+    map(vn, out, [&](std::size_t i) { return V::mul(va, vexp(V::mul(V::load(cols.x + i), vlnb))); });
+    scalar::exponential_values(slice(cols, vn, cols.n), a, b, out + vn);
+}
+
+inline const Table table {
+    V::name,
+    linear_gradient, quadratic_gradient, power_gradient, exponential_gradient,
+    linear_error, quadratic_error, power_error, exponential_error,
+    log,
+    linear_values, quadratic_values, power_values, exponential_values
+};
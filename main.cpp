@@ -2,9 +2,21 @@
 #include <cmath>
 #include <iostream>
 #include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <raylib.h>
 #include "functions.hpp"
+#include "drawing.hpp"
+#include "point_renderer.hpp"
+#include "point_store.hpp"
+#include "solver.hpp"
+#include "scheduler.hpp"
 #include "regressions.hpp"
+#include "snapshot.hpp"
+#include "dataset.hpp"
+#include "stream.hpp"
 #define RAYGUI_IMPLEMENTATION
 #define RAYGUI_CUSTOM_ICONS
 #include "ricons.h"
@@ -12,62 +24,68 @@
 
 #define xstr(s) #s
 #define str(s) xstr(s)
-#define MAX_ITERATIONS_PER_FRAME 1000
+#define MAX_FRAME_BUDGET_MS 16
 
 const int screen_width = 800;
 const int screen_height = 800;
 const int interface_width = 250;
 const int interface_height = screen_height;
+const char *const session_path = "session.snap";
 
-void draw_dash_dotted_line(float start_x, float start_y, float end_x, float end_y, float dash_len, Color color) {
-    const float len_x = end_x - start_x;
-    const float len_y = end_y - start_y;
-    const float step = dash_len / std::sqrt(std::pow(len_x, 2) + std::pow(len_y, 2));
-    const float step_x = step * len_x;
-    const float step_y = step * len_y;
-    float cur_x = start_x,
-          cur_y = start_y;
-
-    // compare independently of direction
-    while (len_x * (cur_x - end_x) < 0 || len_y * (cur_y - end_y) < 0) {
-        float next_x = cur_x + step_x;
-        if (len_x * (next_x - end_x) > 0) {
-            next_x = end_x;
-        }
-        float next_y = cur_y + step_y;
-        if (len_y * (next_y - end_y) > 0) {
-            next_y = end_y;
-        }
-        DrawLine(cur_x, cur_y, next_x, next_y, color);
-        cur_x += 2 * step_x;
-        cur_y += 2 * step_y;
-    }
-}
 
-#define display(r) {\
-    r.calculated.plot(GRAY); \
-    for (int i = 0; i < (int) iterations_per_frame; ++i) r.descent_step(data);\
-    r.descent.plot(BLACK);\
-    r.draw_description(30, 30, 30, GRAY);\
-    float error = r.descent.current_error(data);\
-    DrawText(TextFormat("Error: %.02f", error), 30, 90, 30, GRAY);\
-    for (auto [x, y] : data) {\
-        DrawCircle(x, screen_height - y, 3.0f, RED);\
-        draw_dash_dotted_line(x, std::clamp(screen_height - y, 0.0f, (float) screen_height), x, \
-                std::clamp(screen_height - r.descent.evaluate_at(x), 0.0f, (float) screen_height), 4, BLUE);\
-    } \
+// while the solver runs in the background only its published snapshot is drawn
+#define display(r, solver, curves) {\
+    curves.calculated.plot(r.calculated, GRAY); \
+    decltype(r.descent) shown; /* r.descent belongs to the solver thread while it runs */\
+    if (solver.running()) {\
+        const auto snapshot = solver.snapshot();\
+        shown.set_parameters(snapshot.parameters);\
+        iterations_per_second = snapshot.iterations_per_second;\
+    } else {\
+        if (!data.empty()) scheduler.run([&] { r.descent_step(data); });\
+        shown = r.descent;\
+        iterations_per_second = scheduler.achieved.rate;\
+    }\
+    curves.descent.plot(shown, BLACK);\
+    draw_description(shown, 30, 30, 30, GRAY);\
+    float error = r.current_error(shown, data);\
+    if (verify_error) {\
+        DrawText(TextFormat("Error: %.02f (scan: %.02f)", error, shown.current_error(data)), 30, 90, 30, GRAY);\
+    } else {\
+        DrawText(TextFormat("Error: %.02f", error), 30, 90, 30, GRAY);\
+    }\
+    point_renderer.draw(data, shown);\
 }
 
 enum REGRESSION_TYPE { LINEAR, QUADRATIC, POWER, EXPONENTIAL };
 
-int main() {
+int main(int argc, char **argv) {
     InitWindow(screen_width + interface_width, screen_height, "Regressions");
     GuiSetStyle(DEFAULT, BASE_COLOR_NORMAL, 0xf5f5f5ff); 
     SetTargetFPS(60);
 
-    std::vector<Vector2> data;
+    PointStore data;
+    PointRenderer point_renderer;
     REGRESSION_TYPE current_regression = LINEAR;
-    float iterations_per_frame = 1;
+    IterationScheduler scheduler;
+    double iterations_per_second = 0.0;
+    bool from_moments = false;
+    bool parallel = false;
+    bool background = false;
+    bool fit_all = false;
+    bool auto_select = false;
+    bool verify_error = false;
+    int criterion = 0; // index into "AIC;BIC"
+    int history = 0; // index into "All;Window;Decay": which points the fits are made over
+    float window_size = 50.0f;
+    float forgetting = 0.98f;
+    /* the points kept for display in Decay mode; the sums don't downdate the ones pushed out,
+     * at the slowest forgetting (0.999) a point this old weighs about 1e-7 anyway
+     */
+    constexpr std::size_t decay_window = 1 << 14;
+    // hidden regressions share the cores the render thread and the visible one leave free
+    const float hidden_duty = std::clamp((std::thread::hardware_concurrency() - 2.0f) / 3.0f, 0.1f, 1.0f);
+    ThreadPool pool;
     LinearRegression lr;
     QuadraticRegression qr;
     PowerRegression pr;
@@ -75,6 +93,74 @@ int main() {
 
     Regression* regressions[] { &lr, &qr, &pr, &er };
 
+    // guards data and the regressions' sums while solver threads are running
+    DataLock data_lock;
+    Solver<LinearRegression> ls(lr, data, data_lock);
+    Solver<QuadraticRegression> qs(qr, data, data_lock);
+    Solver<PowerRegression> ps(pr, data, data_lock);
+    Solver<ExponentialRegression> es(er, data, data_lock);
+
+    // on-screen geometry of each regression's curves, rebuilt when their parameters change
+    RegressionCurves<LinearFunction> linear_curves;
+    RegressionCurves<QuadraticFunction> quadratic_curves;
+    RegressionCurves<PowerFunction> power_curves;
+    RegressionCurves<ExponentialFunction> exponential_curves;
+
+    auto load_session = [&](const char *path) {
+        std::lock_guard<DataLock> lock(data_lock);
+        if (!snapshot::load(path, data, {lr, qr, pr, er})) return false;
+        // the controls follow the restored session instead of overriding it
+        history = lr.forgetting < 1.0 ? 2 : data.capacity() ? 1 : 0;
+        if (history == 1) window_size = data.capacity();
+        if (history == 2) forgetting = lr.forgetting;
+        return true;
+    };
+    // a dataset replaces the points, every regression is refitted over it in one bulk pass
+    auto load_points = [&](const char *path) {
+        const dataset::Report report = dataset::load(path, &pool, [&](const Vector2 *points, std::size_t count) {
+            std::lock_guard<DataLock> lock(data_lock);
+            data.assign(points, count);
+            const std::size_t first = data.capacity() && count > data.capacity() ? count - data.capacity() : 0;
+            for (auto regression: regressions) regression->reset();
+            add_points(lr, &pool, points + first, count - first);
+            add_points(qr, &pool, points + first, count - first);
+            add_points(pr, &pool, points + first, count - first);
+            add_points(er, &pool, points + first, count - first);
+        });
+        if (report.ok) {
+            std::cout << path << ": " << report.points << " points, " << report.skipped << " lines skipped, "
+                      << report.bytes / 1e6 << " MB in " << report.seconds << " s, "
+                      << report.megabytes_per_second() << " MB/s" << std::endl;
+        }
+        return report.ok;
+    };
+    // the sums over exactly the points in data, in their order; the caller holds data_lock
+    auto refit = [&] {
+        std::vector<Vector2> points;
+        points.reserve(data.size());
+        for (auto point : data) points.push_back(point);
+        for (auto regression: regressions) regression->forget_points();
+        add_points(lr, &pool, points.data(), points.size());
+        add_points(qr, &pool, points.data(), points.size());
+        add_points(pr, &pool, points.data(), points.size());
+        add_points(er, &pool, points.data(), points.size());
+    };
+    // snapshots are told apart by their header, everything else is taken for a dataset
+    auto open_file = [&](const char *path) {
+        if (!load_session(path) && !load_points(path)) std::cerr << "cannot load " << path << std::endl;
+    };
+    // --stdin streams points from a pipe, --sample drops what the window can't keep up with instead of blocking the pipe
+    bool from_stdin = false;
+    StreamReader::Overflow overflow = StreamReader::Overflow::BLOCK;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--stdin") == 0) from_stdin = true;
+        else if (std::strcmp(argv[i], "--sample") == 0) overflow = StreamReader::Overflow::SAMPLE;
+        else open_file(argv[i]);
+    }
+    std::unique_ptr<StreamReader> stream;
+    if (from_stdin) stream = std::make_unique<StreamReader>(STDIN_FILENO, overflow);
+    std::vector<Vector2> incoming(1 << 16), evictions;
+
     while (!WindowShouldClose()) {
 
         if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT) && GetMouseX() < screen_width) {
@@ -82,51 +168,104 @@ int main() {
                 .x = (float) GetMouseX(),
                 .y = (float) (screen_height - GetMouseY())
             };
-            data.push_back(point);
+            std::lock_guard<DataLock> lock(data_lock);
+            const auto evicted = data.push_back(point);
             for (auto regression: regressions) {
+                if (evicted) regression->remove_point(*evicted);
                 regression->add_point(point);
             }
         }
 
+        if (stream) {
+            // what arrived since the last frame goes in as one batch; points the window pushes out
+            // come off the sums first, even ones from this batch (the sums don't mind the order)
+            const std::size_t count = stream->drain(incoming.data(), incoming.size());
+            if (count > 0) {
+                std::lock_guard<DataLock> lock(data_lock);
+                evictions.clear();
+                for (std::size_t i = 0; i < count; ++i) {
+                    if (const auto point = data.push_back(incoming[i])) evictions.push_back(*point);
+                }
+                for (auto regression: regressions) {
+                    regression->remove_points(evictions.data(), evictions.size());
+                    regression->add_points(incoming.data(), count);
+                }
+            }
+        }
+
         if (IsKeyPressed(KEY_ONE)) current_regression = LINEAR;
         if (IsKeyPressed(KEY_TWO)) current_regression = QUADRATIC;
         if (IsKeyPressed(KEY_THREE)) current_regression = POWER;
         if (IsKeyPressed(KEY_FOUR)) current_regression = EXPONENTIAL;
 
+        if (IsKeyPressed(KEY_S)) {
+            std::lock_guard<DataLock> lock(data_lock);
+            if (!snapshot::save(session_path, data, {lr, qr, pr, er})) std::cerr << "cannot save " << session_path << std::endl;
+        }
+        if (IsKeyPressed(KEY_L) && !load_session(session_path)) std::cerr << "cannot load " << session_path << std::endl;
+        if (IsFileDropped()) {
+            const FilePathList dropped = LoadDroppedFiles();
+            for (unsigned i = 0; i < dropped.count; ++i) open_file(dropped.paths[i]);
+            UnloadDroppedFiles(dropped);
+        }
+
+        // scored from the running sums, so this costs the same for any number of points
+        const int best = best_fit(regressions, 4, criterion == 0 ? Criterion::AIC : Criterion::BIC);
+        if (auto_select && best >= 0) current_regression = (REGRESSION_TYPE) best;
+
+        // the visible regression descends in the background at full speed,
+        // with fit_all the others keep descending too so switching to them is instant
+        auto schedule = [&](auto &solver, bool visible) {
+            solver.duty = visible ? 1.0f : hidden_duty;
+            if (background && (visible || fit_all)) solver.start(); else solver.stop();
+        };
+        schedule(ls, current_regression == LINEAR);
+        schedule(qs, current_regression == QUADRATIC);
+        schedule(ps, current_regression == POWER);
+        schedule(es, current_regression == EXPONENTIAL);
+
         BeginDrawing();
             ClearBackground(RAYWHITE);
 
             switch(current_regression) {
                 case LINEAR: 
                     {
-                        display(lr);
+                        display(lr, ls, linear_curves);
                     }
                     break;
                 case QUADRATIC: 
                     {   
-                        display(qr);
+                        display(qr, qs, quadratic_curves);
                     }
                     break;
                 case POWER:
                     {
-                        display(pr);
+                        display(pr, ps, power_curves);
                     }
                     break;
                 case EXPONENTIAL:
                     {
-                        display(er);
+                        display(er, es, exponential_curves);
                     }
                     break;
 
             }
 
+            if (stream) {
+                DrawText(TextFormat("Stream: %zu points, %zu dropped, %zu lines skipped%s", stream->received.load(),
+                            stream->dropped.load(), stream->skipped.load(), stream->finished ? ", ended" : ""), 30, 125, 20, GRAY);
+            }
+
             // GUI
             DrawRectangle(screen_width, 0, interface_width, interface_height, LIGHTGRAY);
-            const Rectangle speed_slider {screen_width + interface_width / 10, 60, interface_width * 8 / 10, 40};
-            DrawText("Speed", screen_width + interface_width / 10, 40, 20, GRAY);
-            GuiSliderBar(speed_slider, "1", str(MAX_ITERATIONS_PER_FRAME), &iterations_per_frame, 1.0f, MAX_ITERATIONS_PER_FRAME);
+            const Rectangle budget_slider {screen_width + interface_width / 10, 60, interface_width * 8 / 10, 40};
+            DrawText(TextFormat("Budget: %.1f ms/frame", scheduler.budget_ms), screen_width + interface_width / 10, 40, 20, GRAY);
+            GuiSliderBar(budget_slider, "1", str(MAX_FRAME_BUDGET_MS), &scheduler.budget_ms, 1.0f, MAX_FRAME_BUDGET_MS);
+            DrawText(TextFormat("%llu it/frame", (unsigned long long) scheduler.last_count), screen_width + interface_width / 10, 110, 20, GRAY);
+            DrawText(TextFormat("%.3g it/s", iterations_per_second), screen_width + interface_width / 10, 135, 20, GRAY);
             const Rectangle restart_button {screen_width + interface_width / 5, interface_height - 100, interface_width * 3 / 5, 80};
             if (GuiButton(restart_button, "Restart")) {
+                std::lock_guard<DataLock> lock(data_lock);
                 data.clear();
                 for (auto regression: regressions) {
                     regression->reset();
@@ -140,6 +279,65 @@ int main() {
             if (GuiButton(pp_button, "#221#")) current_regression = POWER;
             const Rectangle ep_button {screen_width + interface_width * 2 / 4, interface_height * 1 / 4 + interface_width / 4, interface_width / 4, interface_width / 4};
             if (GuiButton(ep_button, "#222#")) current_regression = EXPONENTIAL;
+            const Rectangle family_buttons[] { lp_button, qp_button, pp_button, ep_button };
+            if (best >= 0) DrawRectangleLinesEx(family_buttons[best], 3, DARKGREEN);
+            const Rectangle moments_checkbox {screen_width + interface_width / 10, interface_height * 1 / 4 + interface_width / 2 + 20, 20, 20};
+            GuiCheckBox(moments_checkbox, "Gradient from sums", &from_moments);
+            const Rectangle parallel_checkbox {screen_width + interface_width / 10, interface_height * 1 / 4 + interface_width / 2 + 50, 20, 20};
+            GuiCheckBox(parallel_checkbox, TextFormat("Parallel (%u threads)", pool.size()), &parallel);
+            ThreadPool *const scan_pool = parallel ? &pool : nullptr;
+            if (lr.from_moments != from_moments || lr.pool != scan_pool) {
+                std::lock_guard<DataLock> lock(data_lock);
+                for (auto regression: regressions) {
+                    regression->from_moments = from_moments;
+                    regression->pool = scan_pool;
+                }
+            }
+            const Rectangle background_checkbox {screen_width + interface_width / 10, interface_height * 1 / 4 + interface_width / 2 + 80, 20, 20};
+            GuiCheckBox(background_checkbox, "Solve in background", &background);
+            const Rectangle fit_all_checkbox {screen_width + interface_width / 10, interface_height * 1 / 4 + interface_width / 2 + 110, 20, 20};
+            GuiCheckBox(fit_all_checkbox, "Fit all regressions", &fit_all);
+            DrawText(TextFormat("Kernels: %s", kernels::active().name), screen_width + interface_width / 10, interface_height * 1 / 4 + interface_width / 2 + 140, 20, GRAY);
+            const Rectangle auto_select_checkbox {screen_width + interface_width / 10, interface_height * 1 / 4 + interface_width / 2 + 170, 20, 20};
+            GuiCheckBox(auto_select_checkbox, "Switch to the best fit", &auto_select);
+            const Rectangle criterion_toggle {screen_width + interface_width / 10, interface_height * 1 / 4 + interface_width / 2 + 200, 60, 20};
+            GuiToggleGroup(criterion_toggle, "AIC;BIC", &criterion);
+            const char *family_names[] { "Linear", "Quadratic", "Power", "Exponential" };
+            for (int i = 0; i < 4; ++i) {
+                const Regression::Score score = regressions[i]->score();
+                const int row_y = interface_height * 1 / 4 + interface_width / 2 + 230 + 15 * i;
+                const Color row_color = i == best ? DARKGREEN : GRAY;
+                if (score.valid) {
+                    DrawText(TextFormat("%-11s R2 %.3f %s %.1f", family_names[i], score.r2, criterion == 0 ? "AIC" : "BIC",
+                                criterion == 0 ? score.aic : score.bic), screen_width + interface_width / 10, row_y, 10, row_color);
+                } else {
+                    DrawText(TextFormat("%-11s -", family_names[i]), screen_width + interface_width / 10, row_y, 10, row_color);
+                }
+            }
+            const Rectangle verify_checkbox {screen_width + interface_width / 10, interface_height * 1 / 4 + interface_width / 2 + 295, 20, 20};
+            GuiCheckBox(verify_checkbox, "Verify error by scan", &verify_error);
+            const Rectangle history_toggle {screen_width + interface_width / 10, interface_height * 1 / 4 + interface_width / 2 + 325, 60, 20};
+            GuiToggleGroup(history_toggle, "All;Window;Decay", &history);
+            const Rectangle history_slider {screen_width + interface_width / 10, interface_height * 1 / 4 + interface_width / 2 + 350, interface_width * 6 / 10, 15};
+            if (history == 1) {
+                GuiSliderBar(history_slider, "", TextFormat("%d", (int) window_size), &window_size, 2.0f, 500.0f);
+            } else if (history == 2) {
+                GuiSliderBar(history_slider, "", TextFormat("%.3f", forgetting), &forgetting, 0.9f, 0.999f);
+            }
+            const double lambda = history == 2 ? forgetting : 1.0;
+            const std::size_t window = history == 1 ? (std::size_t) window_size : history == 2 ? decay_window : 0;
+            if (lr.forgetting != lambda || data.capacity() != window) {
+                std::lock_guard<DataLock> lock(data_lock);
+                const std::vector<Vector2> dropped = data.set_window(window);
+                if (lr.forgetting != lambda) {
+                    // decayed sums can't be reweighted or downdated, they start over from the points kept
+                    for (auto regression: regressions) regression->forgetting = lambda;
+                    refit();
+                } else {
+                    // shrinking the window takes its oldest points back out of the sums (not decayed ones)
+                    for (auto regression: regressions) regression->remove_points(dropped.data(), dropped.size());
+                }
+            }
 
         EndDrawing();
     }
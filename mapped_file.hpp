@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* a whole file mapped read-only, the pages are read in by the kernel as they are touched
+ * an unreadable or empty file leaves it invalid
+ */
+struct MappedFile {
+    explicit MappedFile(const char *path) {
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                ::madvise(p, st.st_size, MADV_SEQUENTIAL);
+                bytes = static_cast<const char *>(p);
+                length = st.st_size;
+            }
+        }
+        ::close(fd); // the mapping keeps the file open
+    }
+
+    ~MappedFile() {
+        if (bytes) ::munmap(const_cast<char *>(bytes), length);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    explicit operator bool() const { return bytes != nullptr; }
+    const char *data() const { return bytes; }
+    std::size_t size() const { return length; }
+
+    private:
+        const char *bytes = nullptr;
+        std::size_t length = 0;
+};
@@ -0,0 +1,172 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <typeinfo>
+#include <vector>
+#include <raylib.h>
+#include <rlgl.h>
+#include <raymath.h>
+#include "point_store.hpp"
+
+extern const int screen_width, screen_height;
+
+/* the data points and their residual lines as two meshes that live on the GPU
+ *
+ * every point is a textured quad: a round marker, or a 1px wide residual line from the point
+ * to the curve whose texture coordinate counts dash periods along it, so a repeating dash texture
+ * draws the dashes; the quads are rebuilt and uploaded only when the points (the store's revision)
+ * or the curve change, and each mesh is one draw call however many points there are
+ */
+struct PointRenderer {
+    // needs the window's GL context, so after InitWindow
+    PointRenderer() {
+        Image marker = GenImageColor(marker_texture, marker_texture, BLANK);
+        const float center = marker_texture / 2.0f, radius = center - 1.0f;
+        for (int y = 0; y < marker_texture; ++y) {
+            for (int x = 0; x < marker_texture; ++x) {
+                // the pixel's coverage of the disc, for a smooth edge
+                const float d = std::hypot(x + 0.5f - center, y + 0.5f - center);
+                const float coverage = std::clamp(radius + 0.5f - d, 0.0f, 1.0f);
+                ImageDrawPixel(&marker, x, y, {255, 255, 255, (unsigned char) (255 * coverage)});
+            }
+        }
+        markers.material.maps[MATERIAL_MAP_DIFFUSE].texture = load_texture(marker, TEXTURE_FILTER_BILINEAR);
+        markers.material.maps[MATERIAL_MAP_DIFFUSE].color = RED;
+
+        // dash_length pixels on, dash_length off
+        Image dash = GenImageColor(1, 2 * dash_length, BLANK);
+        for (int y = 0; y < dash_length; ++y) ImageDrawPixel(&dash, 0, y, WHITE);
+        residuals.material.maps[MATERIAL_MAP_DIFFUSE].texture = load_texture(dash, TEXTURE_FILTER_POINT);
+        residuals.material.maps[MATERIAL_MAP_DIFFUSE].color = BLUE;
+    }
+
+    PointRenderer(const PointRenderer &) = delete;
+    PointRenderer &operator=(const PointRenderer &) = delete;
+
+    // the points of data with their residuals to curve, a function with evaluate_many and parameters()
+    template <class F>
+    void draw(const PointStore &data, const F &curve) {
+        if (markers.revision != data.revision() || !markers.built) build_markers(data);
+        const auto p = curve.parameters();
+        const bool same_curve = residual_family == &typeid(F) && std::equal(p.begin(), p.end(), residual_parameters.begin(), residual_parameters.end());
+        if (residuals.revision != data.revision() || !residuals.built || !same_curve) {
+            fitted.resize(data.size());
+            curve.evaluate_many(data.columns(), fitted.data());
+            build_residuals(data);
+            residual_family = &typeid(F);
+            residual_parameters.assign(p.begin(), p.end());
+        }
+
+        rlDrawRenderBatchActive(); // whatever was drawn before goes under the points
+        rlDisableBackfaceCulling();
+        markers.draw();
+        residuals.draw();
+        rlEnableBackfaceCulling();
+    }
+
+    private:
+        static constexpr int marker_texture = 16;
+        static constexpr float marker_radius = 3.5f; // on the screen, the texture's disc fills most of the quad
+        static constexpr int dash_length = 4;
+
+        // quads as pairs of triangles in one dynamic mesh, the GPU buffers only grow
+        struct Quads {
+            Quads() : material(LoadMaterialDefault()) {}
+            ~Quads() {
+                unload();
+                UnloadMaterial(material); // the texture too
+            }
+
+            // starts a new set of quads, positions and texture coordinates are added per vertex
+            void clear() {
+                vertices.clear();
+                texcoords.clear();
+            }
+
+            // corners in the order top left, bottom left, bottom right, top right
+            void add(const Vector2 (&corners)[4], const Vector2 (&uv)[4]) {
+                for (int i : {0, 1, 2, 0, 2, 3}) {
+                    vertices.insert(vertices.end(), {corners[i].x, corners[i].y, 0.0f});
+                    texcoords.insert(texcoords.end(), {uv[i].x, uv[i].y});
+                }
+            }
+
+            // sends the quads to the GPU, reallocating its buffers when they don't fit
+            void upload(std::size_t revision_now) {
+                const int count = vertices.size() / 3;
+                if (count > capacity) {
+                    unload();
+                    capacity = std::max(count, 2 * capacity);
+                    vertices.resize(3 * capacity);
+                    texcoords.resize(2 * capacity);
+                    mesh = Mesh {};
+                    mesh.vertexCount = capacity;
+                    mesh.triangleCount = capacity / 3;
+                    mesh.vertices = vertices.data();
+                    mesh.texcoords = texcoords.data();
+                    UploadMesh(&mesh, true);
+                    mesh.vertices = mesh.texcoords = nullptr; // ours, UnloadMesh would free them
+                } else if (count > 0) {
+                    UpdateMeshBuffer(mesh, 0, vertices.data(), count * 3 * sizeof(float), 0);
+                    UpdateMeshBuffer(mesh, 1, texcoords.data(), count * 2 * sizeof(float), 0);
+                }
+                mesh.vertexCount = count;
+                mesh.triangleCount = count / 3;
+                revision = revision_now;
+                built = true;
+            }
+
+            void draw() {
+                if (mesh.vertexCount > 0) DrawMesh(mesh, material, MatrixIdentity());
+            }
+
+            void unload() {
+                if (capacity > 0) UnloadMesh(mesh);
+                capacity = 0;
+            }
+
+            Material material;
+            Mesh mesh {};
+            int capacity = 0; // vertices the GPU buffers hold
+            std::vector<float> vertices, texcoords;
+            std::size_t revision = 0;
+            bool built = false;
+        };
+
+        static Texture2D load_texture(Image image, int filter) {
+            const Texture2D texture = LoadTextureFromImage(image);
+            UnloadImage(image);
+            SetTextureFilter(texture, filter);
+            SetTextureWrap(texture, TEXTURE_WRAP_REPEAT);
+            return texture;
+        }
+
+        void build_markers(const PointStore &data) {
+            const kernels::Columns cols = data.columns();
+            markers.clear();
+            for (std::size_t i = 0; i < cols.n; ++i) {
+                const float x = cols.x[i], y = screen_height - cols.y[i], r = marker_radius;
+                markers.add({{x - r, y - r}, {x - r, y + r}, {x + r, y + r}, {x + r, y - r}}, {{0, 0}, {0, 1}, {1, 1}, {1, 0}});
+            }
+            markers.upload(data.revision());
+        }
+
+        // from the point (v = 0) to the curve (v = length in dash periods), both ends kept on the screen
+        void build_residuals(const PointStore &data) {
+            const kernels::Columns cols = data.columns();
+            residuals.clear();
+            for (std::size_t i = 0; i < cols.n; ++i) {
+                const float x = cols.x[i];
+                const float from = std::clamp(screen_height - cols.y[i], 0.0f, (float) screen_height);
+                const float to = std::isnan(fitted[i]) ? from : std::clamp(screen_height - fitted[i], 0.0f, (float) screen_height);
+                const float v = std::abs(to - from) / (2 * dash_length);
+                residuals.add({{x - 0.5f, from}, {x - 0.5f, to}, {x + 0.5f, to}, {x + 0.5f, from}}, {{0, 0}, {0, v}, {1, v}, {1, 0}});
+            }
+            residuals.upload(data.revision());
+        }
+
+        Quads markers, residuals;
+        std::vector<float> fitted;
+        const std::type_info *residual_family = nullptr;
+        std::vector<float> residual_parameters;
+};
@@ -0,0 +1,200 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <new>
+#include <optional>
+#include <vector>
+#include "kernels.hpp"
+#include "vector2.hpp"
+
+template <class T, std::size_t Align = 64>
+struct AlignedAllocator {
+    using value_type = T;
+    template <class U> struct rebind { using other = AlignedAllocator<U, Align>; };
+
+    AlignedAllocator() = default;
+    template <class U> AlignedAllocator(const AlignedAllocator<U, Align> &) {}
+
+    T *allocate(std::size_t n) {
+        return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(Align)));
+    }
+    void deallocate(T *p, std::size_t) {
+        ::operator delete(p, std::align_val_t(Align));
+    }
+    template <class U> bool operator==(const AlignedAllocator<U, Align> &) const { return true; }
+    template <class U> bool operator!=(const AlignedAllocator<U, Align> &) const { return false; }
+};
+
+using AlignedFloats = std::vector<float, AlignedAllocator<float>>;
+
+/* the dataset as a structure of arrays: x and y in separate cache-line aligned columns
+ * plus derived columns that are computed once on insertion instead of on every iteration
+ *
+ * with a window the columns become ring buffers of the last `window` points; every point is
+ * written twice, window apart, so the live range is always contiguous for the kernels
+ * and memory stays at 2 * window floats per column however many points go through
+ */
+struct PointStore {
+    enum Column : unsigned {
+        X2  = 1 << 0,
+        LNX = 1 << 1,
+        LNY = 1 << 2,
+    };
+
+    explicit PointStore(unsigned cached = LNX | LNY, std::size_t window = 0) : cached(cached) {
+        set_window(window);
+    }
+
+    // returns the point the window pushed out, if any
+    std::optional<Vector2> push_back(Vector2 point) {
+        revisions += 1;
+        if (!window) {
+            append(point);
+            count += 1;
+            return std::nullopt;
+        }
+        std::optional<Vector2> evicted;
+        if (count == window) {
+            evicted = (*this)[0];
+            start = (start + 1) % window;
+            count -= 1;
+        }
+        const std::size_t slot = (start + count) % window;
+        write(slot, point);
+        write(slot + window, point);
+        count += 1;
+        return evicted;
+    }
+
+    /* 0 makes the store unbounded; shrinking drops the oldest points,
+     * which are returned so the caller can take them out of its sums
+     */
+    std::vector<Vector2> set_window(std::size_t size) {
+        std::vector<Vector2> dropped, kept;
+        const std::size_t drop = size && count > size ? count - size : 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            (i < drop ? dropped : kept).push_back((*this)[i]);
+        }
+        window = size;
+        clear();
+        for (auto point : kept) push_back(point);
+        return dropped;
+    }
+
+    void clear() {
+        xs.assign(2 * window, 0.0f);
+        ys.assign(2 * window, 0.0f);
+        x2s.assign(cached & X2 ? 2 * window : 0, 0.0f);
+        lnxs.assign(cached & LNX ? 2 * window : 0, 0.0f);
+        lnys.assign(cached & LNY ? 2 * window : 0, 0.0f);
+        start = count = 0;
+        revisions += 1;
+    }
+
+    /* replaces the points by a copy of the columns, derived ones are copied when given and computed otherwise;
+     * a window keeps the last points only
+     */
+    void assign(const kernels::Columns &cols) {
+        clear();
+        if (window) { // at most window points, filling the ring one by one is cheap
+            for (std::size_t i = cols.n > window ? cols.n - window : 0; i < cols.n; ++i) {
+                push_back({cols.x[i], cols.y[i]});
+            }
+            return;
+        }
+        count = cols.n;
+        xs.assign(cols.x, cols.x + count);
+        ys.assign(cols.y, cols.y + count);
+        unsigned missing = 0;
+        auto copy = [&](Column column, AlignedFloats &to, const float *from) {
+            if (!(cached & column)) return;
+            if (from) to.assign(from, from + count); else missing |= column;
+        };
+        copy(X2, x2s, cols.x2);
+        copy(LNX, lnxs, cols.lnx);
+        copy(LNY, lnys, cols.lny);
+        derive(missing);
+    }
+
+    // the same for interleaved points, e.g. a batch parsed from a file
+    void assign(const Vector2 *points, std::size_t n) {
+        clear();
+        if (window) {
+            for (std::size_t i = n > window ? n - window : 0; i < n; ++i) push_back(points[i]);
+            return;
+        }
+        count = n;
+        xs.resize(count);
+        ys.resize(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            xs[i] = points[i].x;
+            ys[i] = points[i].y;
+        }
+        derive(cached);
+    }
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    std::size_t capacity() const { return window; }
+    // changes whenever the points do, for caches of anything computed from them
+    std::size_t revision() const { return revisions; }
+    Vector2 operator[](std::size_t i) const { return {xs[start + i], ys[start + i]}; }
+
+    // what the kernels read, absent derived columns are left null
+    kernels::Columns columns() const {
+        return {
+            xs.data() + start, ys.data() + start,
+            cached & X2 ? x2s.data() + start : nullptr,
+            cached & LNX ? lnxs.data() + start : nullptr,
+            cached & LNY ? lnys.data() + start : nullptr,
+            count
+        };
+    }
+
+    struct iterator {
+        const PointStore *store;
+        std::size_t i;
+        Vector2 operator*() const { return (*store)[i]; }
+        iterator &operator++() { ++i; return *this; }
+        bool operator!=(const iterator &other) const { return i != other.i; }
+    };
+    iterator begin() const { return {this, 0}; }
+    iterator end() const { return {this, size()}; }
+
+    private:
+        // fills the given derived columns of an unbounded store from x and y, the logs through the log kernel
+        void derive(unsigned columns) {
+            if (columns & X2) {
+                x2s.resize(count);
+                for (std::size_t i = 0; i < count; ++i) x2s[i] = xs[i] * xs[i];
+            }
+            if (columns & LNX) {
+                lnxs.resize(count);
+                kernels::active().log(xs.data(), lnxs.data(), count);
+            }
+            if (columns & LNY) {
+                lnys.resize(count);
+                kernels::active().log(ys.data(), lnys.data(), count);
+            }
+        }
+
+        void append(Vector2 point) {
+            xs.push_back(point.x);
+            ys.push_back(point.y);
+            if (cached & X2)  x2s.push_back(point.x * point.x);
+            if (cached & LNX) lnxs.push_back(std::log(point.x));
+            if (cached & LNY) lnys.push_back(std::log(point.y));
+        }
+
+        void write(std::size_t i, Vector2 point) {
+            xs[i] = point.x;
+            ys[i] = point.y;
+            if (cached & X2)  x2s[i] = point.x * point.x;
+            if (cached & LNX) lnxs[i] = std::log(point.x);
+            if (cached & LNY) lnys[i] = std::log(point.y);
+        }
+
+        unsigned cached;
+        std::size_t window = 0, start = 0, count = 0, revisions = 0;
+        AlignedFloats xs, ys, x2s, lnxs, lnys;
+};
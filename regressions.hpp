@@ -1,121 +1,263 @@
 #pragma once
 #include "functions.hpp"
+#include "stats.hpp"
 #include <cmath>
 #include <cstddef>
 #include <iostream>
 #include <iomanip>
+#include <limits>
+#include <utility>
+#include <vector>
 
 /* abstract interface for a regression that is able to 
  * draw current gradient descent state and the final (perfect) regression
  */
 struct Regression {
-    virtual void draw_description(int x, int y, int font_size, Color color) = 0; // draw the title and the function
+    // goodness of the calculated fit; sse and r2 are in the space the fit is made in (ln y for power and exponential)
+    struct Score {
+        double sse, r2, aic, bic;
+        bool valid; // enough points and finite values
+    };
+
     virtual void add_point(Vector2 point) = 0;                 // update the calculated (final) regression
-    virtual void descent_step(std::vector<Vector2> &data) = 0; // do one gradient descent iteration
+    virtual void add_points(const Vector2 *points, std::size_t count) = 0; // add_point for each, solved once
+    virtual void remove_point(Vector2 point) = 0;              // take back a point added before, O(1)
+    virtual void remove_points(const Vector2 *points, std::size_t count) = 0; // remove_point for each, solved once
+    virtual void forget_points() = 0;                          // drop the sums of every point, the descent stays where it is
+    virtual void descent_step(const PointStore &data) = 0; // do one gradient descent iteration
     virtual void reset() = 0;
+    virtual Score score() const = 0;                           // O(1), from the running sums
+
+    bool from_moments = false; // take the gradient from the running sums instead of scanning the data
+    /* lambda in (0, 1]: add_point first scales every running sum by it, so a point added k points ago
+     * weighs lambda^k (recursive least squares with forgetting). below 1 the descent always
+     * works from the sums, a scan of the data can't weigh the points, and remove_point does nothing:
+     * the weight left to take back is unknown. changing it leaves the sums weighted the old way,
+     * forget_points and add the points again for a fit under the new lambda
+     */
+    double forgetting = 1.0;
+    ThreadPool *pool = nullptr; // split the scans over the pool threads when set
+
+    protected:
+        // calls f(ln x, ln y, point) for every point, the logs are taken a block at a time by the log kernel
+        template <class F>
+        static void for_each_log(const Vector2 *points, std::size_t count, F f) {
+            constexpr std::size_t block = 512;
+            float logs[2 * block];
+            for (std::size_t start = 0; start < count; start += block) {
+                const std::size_t m = std::min(block, count - start);
+                kernels::active().log(&points[start].x, logs, 2 * m); // x and y interleaved, as in Vector2
+                for (std::size_t i = 0; i < m; ++i) {
+                    f(logs[2 * i], logs[2 * i + 1], points[start + i]);
+                }
+            }
+        }
+
+        /* gaussian log-likelihood of the residuals with k fitted parameters plus the variance;
+         * fits made in log space add the jacobian -sum ln y so that every family
+         * is scored as a density of y and their criteria can be compared
+         */
+        static Score make_score(double sse, double sst, double n, int k, double log_jacobian = 0.0) {
+            Score score {};
+            sse = std::max(sse, 0.0); // differences of sums can round below zero
+            const int parameters = k + 1;
+            if (n <= parameters || sse <= 0.0) return score;
+            const double log_likelihood = -0.5 * n * (std::log(2 * M_PI * sse / n) + 1) - log_jacobian;
+            score.sse = sse;
+            score.r2 = sst > 0.0 ? 1.0 - sse / sst : 0.0;
+            score.aic = 2 * parameters - 2 * log_likelihood;
+            score.bic = parameters * std::log(n) - 2 * log_likelihood;
+            score.valid = std::isfinite(score.aic) && std::isfinite(score.bic);
+            return score;
+        }
 };
 
-struct LinearRegression : Regression {
+/* the part every family shares: running sums of (u, v) = Derived::map(point) that are updated,
+ * downdated, decayed and merged the same way, and the exact fit Derived::fit(stats) solved from them
+ *
+ * map_all is map over a batch, a family can replace it with one that vectorizes its mapping
+ */
+template <class Derived, class S, class F>
+struct SumsRegression : Regression {
+    using Stats = S;
+
     void add_point(Vector2 point) override {
-        sx += point.x;
-        sy += point.y;
-        sxy += point.x * point.y;
-        sx2 += std::pow(point.x, 2);
-        n += 1;
+        if (forgetting < 1.0) stats.decay(forgetting);
+        const auto [u, v] = Derived::map(point);
+        stats.add(u, v);
+        solve();
+    }
+
+    void add_points(const Vector2 *points, std::size_t count) override {
+        merge(collect(points, count, forgetting), count);
+    }
+
+    void remove_point(Vector2 point) override {
+        if (forgetting < 1.0) return;
+        const auto [u, v] = Derived::map(point);
+        stats.add(u, v, -1.0);
+        solve();
+    }
 
-        calculated.a = (sxy * n - sx * sy) / (sx2 * n - std::pow(sx, 2));
-        calculated.b = (sy - calculated.a * sx) / n;
+    void remove_points(const Vector2 *points, std::size_t count) override {
+        if (forgetting < 1.0) return;
+        Derived::map_all(points, count, [&](double u, double v) { stats.add(u, v, -1.0); });
+        solve();
+    }
+
+    void forget_points() override {
+        stats = Stats();
+        calculated = F();
+    }
+
+    void reset() override {
+        forget_points();
+        descent = F();
+    }
 
+    /* the statistics of a batch on their own, each point decayed by lambda as the next one comes (t = lambda t + term)
+     * safe to call from any thread: shards of a dataset can be collected in parallel and merged in order
+     */
+    static Stats collect(const Vector2 *points, std::size_t count, double lambda = 1.0) {
+        Stats batch;
+        Derived::map_all(points, count, [&](double u, double v) {
+            if (lambda < 1.0) batch.decay(lambda);
+            batch.add(u, v);
+        });
+        return batch;
     }
 
-    void descent_step(std::vector<Vector2> &data) override {
+    // adds the statistics of count points that come after the ones already added and solves once
+    void merge(const Stats &later, std::size_t count) {
+        if (forgetting < 1.0) stats.decay(std::pow(forgetting, count));
+        stats.merge(later);
+        solve();
+    }
+
+    const Stats &statistics() const { return stats; }
+
+    F descent, calculated;
+
+    protected:
+        template <class G>
+        static void map_all(const Vector2 *points, std::size_t count, G g) {
+            for (std::size_t i = 0; i < count; ++i) {
+                const auto [u, v] = Derived::map(points[i]);
+                g(u, v);
+            }
+        }
+
+        Stats stats;
+
+    private:
+        void solve() {
+            if (stats.n == 0) { // drop whatever rounding the downdates left behind
+                stats = Stats();
+                calculated = F();
+                return;
+            }
+            calculated = Derived::fit(stats);
+        }
+};
+
+struct LinearRegression : SumsRegression<LinearRegression, LinearStats, LinearFunction> {
+    static std::pair<double, double> map(Vector2 point) { return {point.x, point.y}; }
+
+    static LinearFunction fit(const Stats &stats) {
+        LinearFunction f;
+        f.a = stats.slope();
+        f.b = stats.intercept(f.a);
+        return f;
+    }
+
+    void descent_step(const PointStore &data) override {
         const float a_weight = 0.000001f;
         const float b_weight = 0.1f;
-        
+
         float a_gradient = 0.0f;
-        for (auto [x, y]: data) {
-            a_gradient += 2 * (descent.a * x + descent.b - y) * x;
-        }
         float b_gradient = 0.0f;
-        for (auto [x, y]: data) {
-            b_gradient += 2 * (descent.a * x + descent.b - y);
-        }
-
-        if (data.size() > 0) {
-            a_gradient /= data.size();
-            b_gradient /= data.size();
+        if (from_moments || forgetting < 1.0) {
+            // sum 2(ax + b - y)x and sum 2(ax + b - y) expanded into the running sums
+            if (stats.n > 0) {
+                a_gradient = stats.slope_gradient(descent.a, descent.b);
+                b_gradient = stats.intercept_gradient(descent.a, descent.b);
+            }
+        } else {
+            // one pass: the residual is shared by both partial derivatives
+            double sums[2];
+            kernels::reduce<2>(pool, data.columns(), sums, [&](const kernels::Columns &cols, double *out) {
+                kernels::active().linear_gradient(cols, descent.a, descent.b, out);
+            });
+            a_gradient = 2 * sums[1];
+            b_gradient = 2 * sums[0];
+
+            if (data.size() > 0) {
+                a_gradient /= data.size();
+                b_gradient /= data.size();
+            }
         }
         descent.a -= a_gradient * a_weight;
         descent.b -= b_gradient * b_weight;
     }
 
-    void draw_description(int x, int y, int font_size, Color color) override {
-        DrawText("Linear regression", x, y, font_size, color);
-        DrawText(TextFormat("y = %.4fx + %.4f", descent.a, descent.b), x, font_size + y, font_size, color);
+    Score score() const override {
+        return make_score(sse(calculated), stats.sst(), stats.n, 2);
     }
 
-    void reset() override {
-        n = sx = sy = sxy = sx2 = 0;
-        descent = calculated = LinearFunction();
+    // sum of squared residuals of any line, expanded into the running sums
+    double sse(const LinearFunction &f) const {
+        return stats.sse(f.a, f.b);
     }
 
-    LinearFunction descent, calculated;
-
-    private:
-        float sx = 0.0f,
-              sy = 0.0f,
-              sxy = 0.0f,
-              sx2 = 0.0f;
-        std::size_t n = 0;
+    // mean squared error of f over the added points in O(1), f.current_error(data) scans them instead
+    float current_error(const LinearFunction &f, const PointStore &) const {
+        return stats.n > 0 ? std::max(sse(f), 0.0) / stats.n : 0.0f;
+    }
 };
 
 inline float sqrt_signed(float x) {
     return x > 0 ? std::sqrt(x) : -std::sqrt(-x);
 }
 
-struct QuadraticRegression : Regression {
-    void draw_description(int x, int y, int font_size, Color color) override {
-        DrawText("Quadratic regression", x, y, font_size, color);
-        DrawText(TextFormat("y = %.4f^2 + %.4fx + %.4f", descent.a, descent.b, descent.c), x, font_size + y, font_size, color);
+struct QuadraticRegression : SumsRegression<QuadraticRegression, QuadraticStats, QuadraticFunction> {
+    static std::pair<double, double> map(Vector2 point) { return {point.x, point.y}; }
+
+    static QuadraticFunction fit(const Stats &stats) {
+        QuadraticFunction f;
+        f.a = stats.a();
+        f.b = stats.b(f.a);
+        f.c = stats.c(f.a, f.b);
+        return f;
     }
-    void add_point(Vector2 point) override {
-        sx4 += std::pow(point.x, 4);
-        sx3 += std::pow(point.x, 3);
-        sx2 += std::pow(point.x, 2);
-        sx += point.x;
-        sx2y += std::pow(point.x, 2) * point.y;
-        sxy += point.x * point.y;
-        sy += point.y;
-        n += 1;
-
-        calculated.a = (n*sx2*sx2y - n*sx3*sxy - std::pow(sx, 2)*sx2y + sx*sx2*sxy + sx*sx3*sy - std::pow(sx2, 2)*sy)
-            /
-            (n*sx2*sx4 - n*std::pow(sx3, 2) - std::pow(sx, 2)*sx4 + 2*sx*sx2*sx3 - std::pow(sx2, 3));
-        calculated.b = (-calculated.a*n*sx3 + calculated.a*sx*sx2 + n*sxy - sx*sy)/(n*sx2 - std::pow(sx, 2));
-        calculated.c = (-calculated.a*sx2 - calculated.b*sx + sy)/n;
-    }
-
-    virtual void descent_step(std::vector<Vector2> &data) override {
+
+    virtual void descent_step(const PointStore &data) override {
         const float a_weight = 0.00000002f;
         const float b_weight = 0.000001f;
         const float c_weight = 0.000001f;
-        
+
         float a_gradient = 0.0f;
-        for (auto [x, y]: data) {
-            a_gradient += 2 * (descent.a * std::pow(x, 2) + descent.b * x + descent.c - y) * std::pow(x, 2);
-        }
         float b_gradient = 0.0f;
-        for (auto [x, y]: data) {
-            b_gradient += 2 * (descent.a * std::pow(x, 2) + descent.b * x + descent.c - y) * x;
-        }
         float c_gradient = 0.0f;
-        for (auto [x, y]: data) {
-            c_gradient += 2 * (descent.a * std::pow(x, 2) + descent.b * x + descent.c - y);
-        }
-        if (data.size() > 0) {
-            a_gradient /= std::pow(data.size(), 2);
-            b_gradient /= data.size();
-            c_gradient /= data.size();
+        if (from_moments || forgetting < 1.0) {
+            const Stats &s = stats;
+            if (s.n > 0) {
+                a_gradient = 2 * (descent.a * s.sx4 + descent.b * s.sx3 + descent.c * s.sx2 - s.sx2y) / std::pow(s.n, 2);
+                b_gradient = 2 * (descent.a * s.sx3 + descent.b * s.sx2 + descent.c * s.sx - s.sxy) / s.n;
+                c_gradient = 2 * (descent.a * s.sx2 + descent.b * s.sx + descent.c * s.n - s.sy) / s.n;
+            }
+        } else {
+            double sums[3];
+            kernels::reduce<3>(pool, data.columns(), sums, [&](const kernels::Columns &cols, double *out) {
+                kernels::active().quadratic_gradient(cols, descent.a, descent.b, descent.c, out);
+            });
+            a_gradient = 2 * sums[2];
+            b_gradient = 2 * sums[1];
+            c_gradient = 2 * sums[0];
+            if (data.size() > 0) {
+                a_gradient /= std::pow(data.size(), 2);
+                b_gradient /= data.size();
+                c_gradient /= data.size();
+            }
         }
 
         descent.a -= sqrt_signed(a_gradient) * a_weight;
@@ -123,136 +265,201 @@ struct QuadraticRegression : Regression {
         descent.c -= sqrt_signed(c_gradient) * c_weight;
     }
 
-    void reset() override { 
-        n = sx4 = sx3 = sx2 = sx = sx2y = sxy = sy;
-        descent = calculated = QuadraticFunction();
+    Score score() const override {
+        return make_score(sse(calculated), stats.sst(), stats.n, 3);
     }
 
-    QuadraticFunction descent, calculated;
+    double sse(const QuadraticFunction &f) const {
+        return stats.sse(f.a, f.b, f.c);
+    }
 
-    private:
-        float sx4 = 0.0f,
-              sx3 = 0.0f,
-              sx2 = 0.0f,
-              sx  = 0.0f,
-              sx2y = 0.0f,
-              sxy = 0.0f,
-              sy = 0.0f;
-        std::size_t n = 0;
+    float current_error(const QuadraticFunction &f, const PointStore &) const {
+        return stats.n > 0 ? std::max(sse(f), 0.0) / stats.n : 0.0f;
+    }
 };
 
-struct PowerRegression : Regression {
-
+struct PowerRegression : SumsRegression<PowerRegression, LinearStats, PowerFunction> { // sums over (ln x, ln y)
     PowerRegression() {
         descent.a = 1.0f;
         descent.b = 1.1f;
     }
 
-    void draw_description(int x, int y, int font_size, Color color) {
-        DrawText("Power regression", x, y, font_size, color);
-        DrawText(TextFormat("y = %.4f * x^%.4f", descent.a, descent.b), x, font_size + y, font_size, color);
+    static std::pair<double, double> map(Vector2 point) { return {std::log(point.x), std::log(point.y)}; }
+
+    template <class G>
+    static void map_all(const Vector2 *points, std::size_t count, G g) {
+        for_each_log(points, count, [&](double lnx, double lny, Vector2) { g(lnx, lny); });
     }
-    void add_point(Vector2 point) {
-        slnx += std::log(point.x);
-        sln2x += std::pow(std::log(point.x), 2);
-        slny += std::log(point.y);
-        slnxlny += std::log(point.x) * std::log(point.y);
-        n += 1;
-        calculated.b = (n * slnxlny - slnx * slny) / (n * sln2x - std::pow(slnx, 2));
-        calculated.a = std::exp((slny - calculated.b * slnx) / n);
+
+    static PowerFunction fit(const Stats &stats) {
+        PowerFunction f;
+        f.b = stats.slope();
+        f.a = std::exp(stats.intercept(f.b));
+        return f;
     }
 
-    void descent_step(std::vector<Vector2> &data) {
+    void descent_step(const PointStore &data) override {
         const float lna_weight = 0.0001f;
         const float b_weight = 0.0001f;
-        
+
         float lna_gradient = 0.0f;
-        for (auto [x, y]: data) {
-            lna_gradient += 2 * (descent.b * std::log(x) + std::log(descent.a) - std::log(y));
-        }
         float b_gradient = 0.0f;
-        for (auto [x, y]: data) {
-            b_gradient += 2 * std::log(x) * (descent.b * std::log(x) + std::log(descent.a) - std::log(y));
-        }
-
-        if (data.size() > 0) {
-            lna_gradient /= data.size();
-            b_gradient /= data.size();
+        if (from_moments || forgetting < 1.0) {
+            // same as the linear case with ln x and ln y in place of x and y
+            if (stats.n > 0) {
+                const double lna = std::log(descent.a);
+                lna_gradient = stats.intercept_gradient(descent.b, lna);
+                b_gradient = stats.slope_gradient(descent.b, lna);
+            }
+        } else {
+            double sums[2];
+            const float lna = std::log(descent.a);
+            kernels::reduce<2>(pool, data.columns(), sums, [&](const kernels::Columns &cols, double *out) {
+                kernels::active().power_gradient(cols, lna, descent.b, out);
+            });
+            lna_gradient = 2 * sums[0];
+            b_gradient = 2 * sums[1];
+
+            if (data.size() > 0) {
+                lna_gradient /= data.size();
+                b_gradient /= data.size();
+            }
         }
         descent.a /= exp(lna_gradient * lna_weight);
         descent.b -= b_gradient * b_weight;
     }
 
-    void reset() {
-        n = slnx = sln2x = slny = slnxlny = 0.0f;
-        descent = calculated = PowerFunction();
+    void reset() override {
+        SumsRegression::reset();
         descent.a = 1.0f;
         descent.b = 1.1f;
     }
 
-    PowerFunction descent, calculated;
+    Score score() const override {
+        return make_score(sse(calculated), stats.sst(), stats.n, 2, stats.sv);
+    }
 
-    private:
-        float slnx = 0.0f,
-              sln2x = 0.0f,
-              slny = 0.0f,
-              slnxlny = 0.0f;
-        std::size_t n = 0;
-};
+    // sum of squared residuals of ln y = ln a + b ln x
+    double sse(const PowerFunction &f) const {
+        return stats.sse(f.b, std::log(f.a));
+    }
 
-struct ExponentialRegression : Regression {
+    // the error is measured in y, which the log-space sums cannot give, so this one scans
+    float current_error(const PowerFunction &f, const PointStore &data) const {
+        return f.current_error(data);
+    }
+};
 
+struct ExponentialRegression : SumsRegression<ExponentialRegression, LinearStats, ExponentialFunction> { // sums over (x, ln y)
     ExponentialRegression() {
          descent.a = 1.0f;
          descent.b = 1.1f;
     }
 
-    void draw_description(int x, int y, int font_size, Color color) {
-        DrawText("Exponential regression", x, y, font_size, color);
-        DrawText(TextFormat("y = %.4f * %.4f^x", descent.a, descent.b), x, font_size + y, font_size, color);
+    static std::pair<double, double> map(Vector2 point) { return {point.x, std::log(point.y)}; }
+
+    template <class G>
+    static void map_all(const Vector2 *points, std::size_t count, G g) {
+        for_each_log(points, count, [&](double, double lny, Vector2 point) { g(point.x, lny); });
     }
-    void add_point(Vector2 point) {
-        sx += point.x;
-        sx2 += std::pow(point.x, 2);
-        slny += std::log(point.y);
-        sxlny += point.x * std::log(point.y);
-        n += 1;
-        float lnb = (n*sxlny - slny*sx)/(n*sx2 - std::pow(sx,2));
-        calculated.b = exp((n*sxlny - slny*sx)/(n*sx2 - std::pow(sx,2)));
-        calculated.a = exp((-lnb*sx + slny)/n);
+
+    static ExponentialFunction fit(const Stats &stats) {
+        ExponentialFunction f;
+        float lnb = stats.slope();
+        f.b = exp(lnb);
+        f.a = exp(stats.intercept(lnb));
+        return f;
     }
-    void descent_step(std::vector<Vector2> &data) {
+
+    void descent_step(const PointStore &data) override {
         const float lna_weight = 0.0001f;
         const float lnb_weight = 0.000001f;
-        
+
         float lna_gradient = 0.0f;
-        for (auto [x, y]: data) {
-            lna_gradient += 2 * std::log(descent.a) + 2 * std::log(descent.b) * x - 2 * std::log(y);
-        }
         float lnb_gradient = 0.0f;
-        for (auto [x, y]: data) {
-            lnb_gradient += 2*x*(std::log(descent.a) + std::log(descent.b)*x - std::log(y));
-        }
-
-        if (data.size() > 0) {
-            lna_gradient /= data.size();
-            lnb_gradient /= data.size();
+        if (from_moments || forgetting < 1.0) {
+            // same as the linear case with ln y in place of y
+            if (stats.n > 0) {
+                const double lna = std::log(descent.a);
+                const double lnb = std::log(descent.b);
+                lna_gradient = stats.intercept_gradient(lnb, lna);
+                lnb_gradient = stats.slope_gradient(lnb, lna);
+            }
+        } else {
+            double sums[2];
+            const float lna = std::log(descent.a), lnb = std::log(descent.b);
+            kernels::reduce<2>(pool, data.columns(), sums, [&](const kernels::Columns &cols, double *out) {
+                kernels::active().exponential_gradient(cols, lna, lnb, out);
+            });
+            lna_gradient = 2 * sums[0];
+            lnb_gradient = 2 * sums[1];
+
+            if (data.size() > 0) {
+                lna_gradient /= data.size();
+                lnb_gradient /= data.size();
+            }
         }
         descent.a /= exp(lna_gradient * lna_weight);
         descent.b /= exp(lnb_gradient * lnb_weight);
     }
-    void reset() {
-        n = sx = sx2 = slny = sxlny = 0.0f;
-        descent = calculated = ExponentialFunction();
+
+    void reset() override {
+        SumsRegression::reset();
         descent.b = 1.1f;
         descent.a = 1.0f;
     }
 
-    ExponentialFunction descent, calculated;
+    Score score() const override {
+        return make_score(sse(calculated), stats.sst(), stats.n, 2, stats.sv);
+    }
+
+    // sum of squared residuals of ln y = ln a + x ln b
+    double sse(const ExponentialFunction &f) const {
+        return stats.sse(std::log(f.b), std::log(f.a));
+    }
 
-    float sx = 0.0f,
-          sx2 = 0.0f,
-          slny = 0.0f,
-          sxlny = 0.0f;
-    std::size_t n = 0;
+    float current_error(const ExponentialFunction &f, const PointStore &data) const {
+        return f.current_error(data);
+    }
 };
+
+/* bulk loading sharded over the pool: every thread collects the statistics of its own shard
+ * without any locking and the shards are merged in order, so the fit is the same as add_points
+ */
+template <class R>
+inline void add_points(R &regression, ThreadPool *pool, const Vector2 *points, std::size_t count) {
+    constexpr std::size_t min_shard = 1 << 14;
+    if (!pool || pool->size() == 1 || count < 2 * min_shard) {
+        regression.add_points(points, count);
+        return;
+    }
+    const std::size_t shards = std::min<std::size_t>(pool->size(), count / min_shard);
+    const std::size_t shard = (count + shards - 1) / shards;
+    std::vector<typename R::Stats> partials(shards);
+    const double lambda = regression.forgetting;
+    pool->run(shards, [&](std::size_t i) {
+        const std::size_t begin = std::min(count, i * shard);
+        partials[i] = R::collect(points + begin, std::min(count, begin + shard) - begin, lambda);
+    });
+    for (std::size_t i = 0; i < shards; ++i) {
+        const std::size_t begin = std::min(count, i * shard);
+        regression.merge(partials[i], std::min(count, begin + shard) - begin);
+    }
+}
+
+enum class Criterion { AIC, BIC };
+
+// index of the regression whose calculated fit has the lowest criterion, -1 while none can be scored
+inline int best_fit(Regression *const regressions[], std::size_t count, Criterion criterion) {
+    int best = -1;
+    double best_value = std::numeric_limits<double>::infinity();
+    for (std::size_t i = 0; i < count; ++i) {
+        const Regression::Score score = regressions[i]->score();
+        const double value = criterion == Criterion::AIC ? score.aic : score.bic;
+        if (score.valid && value < best_value) {
+            best = i;
+            best_value = value;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+// events per second, averaged over windows of at least half a second
+struct RateMeter {
+    using clock = std::chrono::steady_clock;
+
+    void add(std::uint64_t count) {
+        pending += count;
+        const auto now = clock::now();
+        const double elapsed = std::chrono::duration<double>(now - window_start).count();
+        if (elapsed >= 0.5) {
+            rate = pending / elapsed;
+            pending = 0;
+            window_start = now;
+        }
+    }
+
+    double rate = 0.0;
+
+    private:
+        std::uint64_t pending = 0;
+        clock::time_point window_start = clock::now();
+};
+
+/* runs as many iterations per frame as fit in a time budget instead of a fixed count
+ * the cost of an iteration is measured while running, so the count follows the dataset size
+ */
+struct IterationScheduler {
+    using clock = std::chrono::steady_clock;
+
+    explicit IterationScheduler(float budget_ms = 8.0f) : budget_ms(budget_ms) {}
+
+    template <class Step>
+    std::uint64_t run(Step step) {
+        const auto start = clock::now();
+        const auto deadline = start + std::chrono::duration<double, std::milli>(budget_ms);
+        std::uint64_t done = 0, batch = 0; // the first batch is a single step
+        for (auto now = start; now < deadline; now = clock::now()) {
+            // batches double from one and never take more than half of what is predicted to fit,
+            // so a stale estimate (e.g. right after a bulk load) overshoots by little
+            const double left_ns = std::chrono::duration<double, std::nano>(deadline - now).count();
+            batch = std::max<std::uint64_t>(1, std::min<double>(2 * batch, left_ns / cost_ns / 2));
+            for (std::uint64_t i = 0; i < batch; ++i) step();
+            done += batch;
+            cost_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count() / done;
+        }
+        last_count = done;
+        achieved.add(done);
+        return done;
+    }
+
+    float budget_ms;
+    double cost_ns = 1000.0;      // measured time of one iteration
+    std::uint64_t last_count = 0; // iterations in the last frame
+    RateMeter achieved;           // iterations per second of wall time, frames included
+};
@@ -0,0 +1,183 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include "mapped_file.hpp"
+#include "point_store.hpp"
+#include "regressions.hpp"
+
+/* a session on disk: a fixed header, one record per model with its sufficient statistics
+ * and descent parameters, then the point columns (x, y and the cached derived ones)
+ * each starting on a 64 byte boundary, so saving is one sequential write and loading
+ * is a copy out of a mapping with nothing to parse or accumulate again
+ *
+ * numbers are in the byte order of the machine that wrote them, the header tells which
+ */
+namespace snapshot {
+
+constexpr char magic[8] = "REGSNAP";
+constexpr std::uint32_t version = 1;
+constexpr std::uint32_t byte_order = 0x01020304;
+constexpr std::size_t alignment = 64;
+// a window bigger than this and than the points saved is taken for a damaged header, not allocated
+constexpr std::uint64_t max_window = 1 << 24;
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t points;
+    std::uint64_t window;       // PointStore::capacity(), 0 when unbounded
+    std::uint32_t columns;      // PointStore::Column mask of the derived columns stored after x and y
+    std::uint32_t models;
+    double forgetting;
+    std::uint8_t reserved[16];
+};
+static_assert(sizeof(Header) == 64);
+
+struct Model {
+    std::uint32_t family;       // 0 linear, 1 quadratic, 2 power, 3 exponential
+    std::uint32_t stats_size;   // bytes of stats in use
+    double stats[10];
+    float descent[4];
+    std::uint8_t reserved[24];
+};
+static_assert(sizeof(Model) == 128);
+
+// the four regressions of a session, in family order
+struct Models {
+    LinearRegression &linear;
+    QuadraticRegression &quadratic;
+    PowerRegression &power;
+    ExponentialRegression &exponential;
+};
+
+template <class R>
+inline Model record(std::uint32_t family, const R &regression) {
+    using Stats = typename R::Stats;
+    static_assert(std::is_trivially_copyable_v<Stats> && sizeof(Stats) <= sizeof(Model::stats));
+    Model model {};
+    model.family = family;
+    model.stats_size = sizeof(Stats);
+    std::memcpy(model.stats, &regression.statistics(), sizeof(Stats));
+    const auto parameters = regression.descent.parameters();
+    std::copy(parameters.begin(), parameters.end(), model.descent);
+    return model;
+}
+
+template <class R>
+inline bool compatible(const Model &model, std::uint32_t family) {
+    return model.family == family && model.stats_size == sizeof(typename R::Stats);
+}
+
+template <class R>
+inline void restore(const Model &model, R &regression) {
+    typename R::Stats stats;
+    std::memcpy(&stats, model.stats, sizeof(stats));
+    regression.reset();
+    regression.merge(stats, 0);
+    typename decltype(regression.descent)::Parameters parameters;
+    std::copy(model.descent, model.descent + parameters.size(), parameters.begin());
+    regression.descent.set_parameters(parameters);
+}
+
+inline std::size_t padded(std::size_t bytes) {
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+// the columns in the order they are stored, absent derived ones skipped
+inline std::size_t stored_columns(const kernels::Columns &cols, const float *out[5]) {
+    std::size_t count = 0;
+    for (const float *column : {cols.x, cols.y, cols.x2, cols.lnx, cols.lny}) {
+        if (column) out[count++] = column;
+    }
+    return count;
+}
+
+inline bool save(const char *path, const PointStore &data, const Models &models) {
+    std::FILE *file = std::fopen(path, "wb");
+    if (!file) return false;
+    const kernels::Columns cols = data.columns();
+
+    Header header {};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byte_order = byte_order;
+    header.points = cols.n;
+    header.window = data.capacity();
+    header.columns = 0;
+    if (cols.x2) header.columns |= PointStore::X2;
+    if (cols.lnx) header.columns |= PointStore::LNX;
+    if (cols.lny) header.columns |= PointStore::LNY;
+    header.models = 4;
+    header.forgetting = models.linear.forgetting;
+    const Model records[4] {
+        record(0, models.linear), record(1, models.quadratic), record(2, models.power), record(3, models.exponential)
+    };
+
+    static const char zeros[alignment] {};
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+           && std::fwrite(records, sizeof(records), 1, file) == 1;
+    const float *columns[5];
+    const std::size_t stored = stored_columns(cols, columns);
+    const std::size_t bytes = cols.n * sizeof(float);
+    for (std::size_t i = 0; i < stored && ok; ++i) {
+        ok = std::fwrite(columns[i], 1, bytes, file) == bytes
+          && std::fwrite(zeros, 1, padded(bytes) - bytes, file) == padded(bytes) - bytes;
+    }
+    return std::fclose(file) == 0 && ok;
+}
+
+/* the session is only touched once the whole file has been checked,
+ * a missing, foreign or truncated file leaves it as it was
+ */
+inline bool load(const char *path, PointStore &data, const Models &models) {
+    const MappedFile file(path);
+    if (!file || file.size() < sizeof(Header)) return false;
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version
+            || header.byte_order != byte_order || header.models != 4) {
+        return false;
+    }
+    if (header.window && (header.points > header.window || header.window > std::max(header.points, max_window))) return false;
+    if (!(header.forgetting > 0.0 && header.forgetting <= 1.0)) return false; // nan too
+
+    Model records[4];
+    if (file.size() < sizeof(Header) + sizeof(records)) return false;
+    std::memcpy(records, file.data() + sizeof(Header), sizeof(records));
+    if (!compatible<LinearRegression>(records[0], 0) || !compatible<QuadraticRegression>(records[1], 1)
+            || !compatible<PowerRegression>(records[2], 2) || !compatible<ExponentialRegression>(records[3], 3)) {
+        return false;
+    }
+
+    const std::size_t n = header.points;
+    const std::size_t bytes = n * sizeof(float);
+    const std::size_t columns = 2 + ((header.columns & PointStore::X2) != 0)
+        + ((header.columns & PointStore::LNX) != 0) + ((header.columns & PointStore::LNY) != 0);
+    const std::size_t payload = sizeof(Header) + sizeof(records);
+    if (n > file.size() || file.size() < payload + columns * padded(bytes)) return false;
+
+    // the payload offsets are multiples of 64 and the mapping is page aligned, so the columns can be read in place
+    auto column = [&](std::size_t i) { return reinterpret_cast<const float *>(file.data() + payload + i * padded(bytes)); };
+    std::size_t next = 2;
+    kernels::Columns cols {column(0), column(1), nullptr, nullptr, nullptr, n};
+    if (header.columns & PointStore::X2) cols.x2 = column(next++);
+    if (header.columns & PointStore::LNX) cols.lnx = column(next++);
+    if (header.columns & PointStore::LNY) cols.lny = column(next++);
+
+    data.clear();
+    data.set_window(header.window);
+    data.assign(cols);
+    restore(records[0], models.linear);
+    restore(records[1], models.quadratic);
+    restore(records[2], models.power);
+    restore(records[3], models.exponential);
+    models.linear.forgetting = models.quadratic.forgetting = header.forgetting;
+    models.power.forgetting = models.exponential.forgetting = header.forgetting;
+    return true;
+}
+
+} // namespace snapshot
@@ -0,0 +1,159 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
+#include "point_store.hpp"
+#include "scheduler.hpp"
+
+/* single writer, many readers: the writer never waits and readers retry
+ * when they raced with a write, so neither side takes a lock
+ */
+template <class T>
+struct Seqlock {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    void write(const T &value) {
+        unsigned buffer[words] = {};
+        std::memcpy(buffer, &value, sizeof(T));
+        const unsigned s = sequence.load(std::memory_order_relaxed);
+        sequence.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < words; ++i) data[i].store(buffer[i], std::memory_order_relaxed);
+        sequence.store(s + 2, std::memory_order_release);
+    }
+
+    T read() const {
+        unsigned buffer[words];
+        unsigned before, after;
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            for (std::size_t i = 0; i < words; ++i) buffer[i] = data[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while (before != after || (before & 1));
+        T value;
+        std::memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+    private:
+        static constexpr std::size_t words = (sizeof(T) + sizeof(unsigned) - 1) / sizeof(unsigned);
+        std::atomic<unsigned> sequence{0};
+        std::atomic<unsigned> data[words] = {};
+};
+
+/* readers-writer lock over the points and the regressions' sums:
+ * solvers only read them and run side by side, the main thread adding points writes;
+ * a waiting writer keeps new readers out so several solvers cannot starve it
+ */
+struct DataLock {
+    void lock() {
+        ++waiting;
+        mutex.lock();
+        --waiting;
+    }
+    void unlock() { mutex.unlock(); }
+    void lock_shared() {
+        while (waiting > 0) std::this_thread::yield();
+        mutex.lock_shared();
+    }
+    void unlock_shared() { mutex.unlock_shared(); }
+
+    private:
+        std::shared_mutex mutex;
+        std::atomic<int> waiting{0};
+};
+
+/* runs descent_step of one regression on its own thread for as long as it is started
+ * the points and the sums are shared with the main thread under `lock`, which the solver
+ * only holds for short slices; its own descent state is written by it alone and published
+ * through a seqlock so the renderer reads it without locking
+ */
+template <class R>
+struct Solver {
+    using Parameters = typename decltype(R::descent)::Parameters;
+    struct Snapshot {
+        Parameters parameters;
+        std::uint64_t iterations;
+        double iterations_per_second;
+    };
+
+    Solver(R &regression, const PointStore &data, DataLock &lock)
+        : regression(regression), data(data), lock(lock) {}
+
+    ~Solver() { stop(); }
+
+    Solver(const Solver &) = delete;
+    Solver &operator=(const Solver &) = delete;
+
+    void start() {
+        if (thread.joinable()) return;
+        publish(); // the thread is not running yet, so the descent state is ours
+        stopping = false;
+        thread = std::thread([this] { run(); });
+    }
+
+    // joins the thread, after that the regression can be used directly again
+    void stop() {
+        if (!thread.joinable()) return;
+        stopping = true;
+        thread.join();
+    }
+
+    bool running() const { return thread.joinable(); }
+
+    Snapshot snapshot() const { return published.read(); }
+
+    // share of wall time the solver may compute, it sleeps the rest of every slice
+    std::atomic<float> duty{1.0f};
+
+    private:
+        // how long a slice holds the lock, so about the longest the main thread waits for it
+        static constexpr std::chrono::microseconds slice{1000};
+
+        void run() {
+            while (!stopping) {
+                bool idle;
+                {
+                    std::shared_lock<DataLock> shared(lock);
+                    idle = data.empty();
+                    if (!idle) {
+                        // batches sized from the measured cost of a step, so a slice ends near its budget
+                        // whatever the dataset size (one step, when a single step takes longer)
+                        const std::uint64_t done = scheduler.run([&] { regression.descent_step(data); });
+                        iterations += done;
+                        rate.add(done);
+                    }
+                    publish();
+                }
+                const float share = duty;
+                if (idle) {
+                    std::this_thread::sleep_for(slice);
+                } else if (share < 1.0f) {
+                    std::this_thread::sleep_for(slice * ((1.0f - share) / std::max(share, 0.01f)));
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        void publish() {
+            published.write({regression.descent.parameters(), iterations, rate.rate});
+        }
+
+        R &regression;
+        const PointStore &data;
+        DataLock &lock;
+        std::thread thread;
+        std::atomic<bool> stopping{false};
+        std::uint64_t iterations = 0;
+        RateMeter rate;
+        IterationScheduler scheduler{std::chrono::duration<float, std::milli>(slice).count()};
+        Seqlock<Snapshot> published;
+};
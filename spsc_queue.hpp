@@ -0,0 +1,55 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/* bounded queue between exactly one producer thread and one consumer thread
+ * each side owns one index and only reads the other's, so neither ever waits on a lock;
+ * the indices sit on their own cache lines and each side keeps a stale copy of the other's
+ * to touch the shared line only when the copy says the queue looks full (or empty)
+ */
+template <class T>
+struct SpscQueue {
+    explicit SpscQueue(std::size_t capacity) {
+        std::size_t size = 1;
+        while (size < capacity) size <<= 1;
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // producer only, false when the queue is full
+    bool push(const T &item) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head_seen == slots.size()) {
+            head_seen = head.load(std::memory_order_acquire);
+            if (t - head_seen == slots.size()) return false;
+        }
+        slots[t & mask] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only, moves up to max items into out and returns how many
+    std::size_t pop(T *out, std::size_t max) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (tail_seen - h < max) tail_seen = tail.load(std::memory_order_acquire);
+        const std::size_t count = std::min(max, tail_seen - h);
+        for (std::size_t i = 0; i < count; ++i) out[i] = slots[(h + i) & mask];
+        head.store(h + count, std::memory_order_release);
+        return count;
+    }
+
+    std::size_t capacity() const { return slots.size(); }
+
+    private:
+        std::vector<T> slots;
+        std::size_t mask;
+        alignas(64) std::atomic<std::size_t> head {0}; // next slot to pop, written by the consumer
+        std::size_t tail_seen = 0;                     // the consumer's copy of tail
+        alignas(64) std::atomic<std::size_t> tail {0}; // next slot to push, written by the producer
+        std::size_t head_seen = 0;                     // the producer's copy of head
+};
@@ -0,0 +1,108 @@
+#pragma once
+#include <cmath>
+
+/* sufficient statistics of the least squares fits as plain values
+ * the statistics of two disjoint sets of points merge into those of their union exactly,
+ * so shards of a dataset can be summed independently (other threads, other processes) and combined
+ * everything is kept in double: the closed forms and the moment gradients are differences of large sums
+ */
+
+// sums over (u, v) for v = slope * u + intercept,
+// the linear regression feeds (x, y), power (ln x, ln y) and exponential (x, ln y)
+struct LinearStats {
+    double su = 0.0,
+           sv = 0.0,
+           suv = 0.0,
+           su2 = 0.0,
+           sv2 = 0.0;
+    double n = 0.0; // number of points, each weighted by the forgetting factor
+
+    // adds (w = 1) or downdates (w = -1) the terms of one point
+    void add(double u, double v, double w = 1.0) {
+        su += w * u;
+        sv += w * v;
+        suv += w * u * v;
+        su2 += w * u * u;
+        sv2 += w * v * v;
+        n += w;
+    }
+
+    // scales every point added so far by lambda
+    void decay(double lambda) {
+        su *= lambda; sv *= lambda; suv *= lambda; su2 *= lambda; sv2 *= lambda;
+        n *= lambda;
+    }
+
+    void merge(const LinearStats &other) {
+        su += other.su; sv += other.sv; suv += other.suv; su2 += other.su2; sv2 += other.sv2;
+        n += other.n;
+    }
+
+    double slope() const { return (n * suv - su * sv) / (n * su2 - su * su); }
+    double intercept(double slope) const { return (sv - slope * su) / n; }
+
+    // sum of squared residuals of any line, and the total sum of squares of v
+    double sse(double slope, double intercept) const {
+        const double k = slope, c = intercept;
+        return k * k * su2 + 2 * k * c * su + c * c * n - 2 * k * suv - 2 * c * sv + sv2;
+    }
+    double sst() const { return sv2 - sv * sv / n; }
+
+    // partial derivatives of sse / n
+    double slope_gradient(double slope, double intercept) const { return 2 * (slope * su2 + intercept * su - suv) / n; }
+    double intercept_gradient(double slope, double intercept) const { return 2 * (slope * su + intercept * n - sv) / n; }
+};
+
+// sums over (x, y) for y = a * x^2 + b * x + c
+struct QuadraticStats {
+    double sx4 = 0.0,
+           sx3 = 0.0,
+           sx2 = 0.0,
+           sx  = 0.0,
+           sx2y = 0.0,
+           sxy = 0.0,
+           sy = 0.0,
+           syy = 0.0;
+    double n = 0.0;
+
+    void add(double x, double y, double w = 1.0) {
+        const double x2 = x * x;
+        sx4 += w * x2 * x2;
+        sx3 += w * x2 * x;
+        sx2 += w * x2;
+        sx += w * x;
+        sx2y += w * x2 * y;
+        sxy += w * x * y;
+        sy += w * y;
+        syy += w * y * y;
+        n += w;
+    }
+
+    void decay(double lambda) {
+        sx4 *= lambda; sx3 *= lambda; sx2 *= lambda; sx *= lambda;
+        sx2y *= lambda; sxy *= lambda; sy *= lambda; syy *= lambda;
+        n *= lambda;
+    }
+
+    void merge(const QuadraticStats &other) {
+        sx4 += other.sx4; sx3 += other.sx3; sx2 += other.sx2; sx += other.sx;
+        sx2y += other.sx2y; sxy += other.sxy; sy += other.sy; syy += other.syy;
+        n += other.n;
+    }
+
+    // the normal equations solved in closed form (see solutions.py)
+    double a() const {
+        return (n*sx2*sx2y - n*sx3*sxy - std::pow(sx, 2)*sx2y + sx*sx2*sxy + sx*sx3*sy - std::pow(sx2, 2)*sy)
+            /
+            (n*sx2*sx4 - n*std::pow(sx3, 2) - std::pow(sx, 2)*sx4 + 2*sx*sx2*sx3 - std::pow(sx2, 3));
+    }
+    double b(double a) const { return (-a*n*sx3 + a*sx*sx2 + n*sxy - sx*sy)/(n*sx2 - std::pow(sx, 2)); }
+    double c(double a, double b) const { return (-a*sx2 - b*sx + sy)/n; }
+
+    double sse(double a, double b, double c) const {
+        return a * a * sx4 + b * b * sx2 + c * c * n + syy
+            + 2 * (a * b * sx3 + a * c * sx2 + b * c * sx)
+            - 2 * (a * sx2y + b * sxy + c * sy);
+    }
+    double sst() const { return syy - sy * sy / n; }
+};
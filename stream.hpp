@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <poll.h>
+#include <unistd.h>
+#include "dataset.hpp"
+#include "spsc_queue.hpp"
+#include "vector2.hpp"
+
+/* points streamed from a file descriptor (a pipe into stdin): a reader thread parses the lines
+ * as csv (see dataset.hpp) into a bounded queue, the main thread drains it at frame boundaries
+ *
+ * when the queue is full BLOCK stops reading, so the pipe fills up and the producer blocks in turn,
+ * and SAMPLE keeps reading and drops what doesn't fit, so the fit sees a sample of the stream
+ */
+struct StreamReader {
+    enum class Overflow { BLOCK, SAMPLE };
+
+    StreamReader(int fd, Overflow overflow, std::size_t capacity = 1 << 16)
+        : queue(capacity), fd(fd), overflow(overflow), thread([this] { read_loop(); }) {}
+
+    ~StreamReader() {
+        stopping = true;
+        thread.join();
+    }
+
+    StreamReader(const StreamReader &) = delete;
+    StreamReader &operator=(const StreamReader &) = delete;
+
+    // main thread only
+    std::size_t drain(Vector2 *out, std::size_t max) { return queue.pop(out, max); }
+
+    // points parsed, points a full queue made --sample throw away, lines that weren't a point
+    std::atomic<std::size_t> received {0}, dropped {0}, skipped {0};
+    std::atomic<bool> finished {false}; // end of input, whatever is still queued can be drained
+
+    private:
+        void read_loop() {
+            char buffer[1 << 16];
+            std::size_t kept = 0; // an unfinished line carried over from the previous read
+            while (!stopping) {
+                pollfd ready {fd, POLLIN, 0};
+                const int polled = ::poll(&ready, 1, 100); // wakes up now and then to see if it should stop
+                if (polled < 0 && errno != EINTR) break;
+                if (polled <= 0) continue;
+                const ssize_t got = ::read(fd, buffer + kept, sizeof(buffer) - kept);
+                if (got < 0 && errno == EINTR) continue;
+                if (got <= 0) break;
+                const char *begin = buffer, *end = buffer + kept + got;
+                while (const char *eol = static_cast<const char *>(std::memchr(begin, '\n', end - begin))) {
+                    line(begin, eol);
+                    begin = eol + 1;
+                }
+                kept = end - begin;
+                if (kept == sizeof(buffer)) { // a line longer than the buffer is nothing we can parse
+                    skipped += 1;
+                    kept = 0;
+                }
+                std::memmove(buffer, begin, kept);
+            }
+            if (kept > 0 && !stopping) line(buffer, buffer + kept); // the last line may have no newline
+            finished = true;
+        }
+
+        void line(const char *begin, const char *end) {
+            Vector2 point;
+            if (!dataset::parse_line(begin, end, point)) {
+                if (end > begin && !(end - begin == 1 && *begin == '\r')) skipped += 1;
+                return;
+            }
+            received += 1;
+            while (!queue.push(point)) {
+                if (overflow == Overflow::SAMPLE || stopping) {
+                    dropped += 1;
+                    return;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
+
+        SpscQueue<Vector2> queue;
+        int fd;
+        Overflow overflow;
+        std::atomic<bool> stopping {false};
+        std::thread thread; // last, it starts reading as soon as it is constructed
+};
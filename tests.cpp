@@ -0,0 +1,453 @@
+// checks of the numeric core against its reference implementations, without raylib:
+// g++ -std=c++17 -O2 tests.cpp -pthread -o tests && ./tests
+#define HEADLESS
+#include <cfloat>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "point_store.hpp"
+#include "regressions.hpp"
+#include "snapshot.hpp"
+#include "dataset.hpp"
+#include "spsc_queue.hpp"
+
+static int failures = 0;
+
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        failures += 1; \
+        std::fprintf(stderr, "%s:%d: %s failed: ", __FILE__, __LINE__, #condition); \
+        std::fprintf(stderr, __VA_ARGS__); \
+        std::fprintf(stderr, "\n"); \
+    } \
+} while (0)
+
+// equal up to a relative tolerance, with inf and nan only equal to themselves
+static bool close(double a, double b, double tolerance) {
+    if (std::isnan(a) || std::isnan(b)) return std::isnan(a) && std::isnan(b);
+    if (std::isinf(a) || std::isinf(b)) return a == b;
+    return std::abs(a - b) <= tolerance * std::max({std::abs(a), std::abs(b), 1.0});
+}
+
+// positive points with a spread of magnitudes, so every family can take its logarithms
+static std::vector<Vector2> random_points(std::size_t n, unsigned seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> xs(0.5f, 20.0f), ys(0.1f, 500.0f);
+    std::vector<Vector2> points(n);
+    for (auto &p : points) p = {xs(random), ys(random)};
+    return points;
+}
+
+static std::vector<const kernels::Table *> vector_tables() {
+    std::vector<const kernels::Table *> tables;
+    for (kernels::Isa isa : {kernels::Isa::SSE2, kernels::Isa::AVX2, kernels::Isa::AVX512}) {
+        if (const kernels::Table *t = kernels::table(isa)) tables.push_back(t);
+    }
+    return tables;
+}
+
+/* every vectorized kernel against kernels::scalar, on sizes around the vector widths
+ * so the tails are exercised, with the derived columns both cached and computed on the fly
+ */
+static void test_kernels() {
+    const kernels::Table &reference = kernels::scalar::table;
+    for (const kernels::Table *table : vector_tables()) {
+        for (std::size_t n : {0, 1, 3, 15, 17, 31, 33, 100, 1001, 4099}) {
+            const std::vector<Vector2> points = random_points(n, n);
+            for (unsigned cached : {0u, unsigned(PointStore::X2 | PointStore::LNX | PointStore::LNY)}) {
+                PointStore store(cached);
+                store.assign(points.data(), n);
+                const kernels::Columns cols = store.columns();
+                auto check_sums = [&](const char *kernel, const double *got, const double *want, int k) {
+                    for (int i = 0; i < k; ++i) {
+                        CHECK(close(got[i], want[i], 1e-4), "%s %s n=%zu cached=%u out[%d]: %.9g vs %.9g",
+                              table->name, kernel, n, cached, i, got[i], want[i]);
+                    }
+                };
+                double got[3], want[3];
+                table->linear_gradient(cols, 0.7f, 3.0f, got);
+                reference.linear_gradient(cols, 0.7f, 3.0f, want);
+                check_sums("linear_gradient", got, want, 2);
+                table->quadratic_gradient(cols, 0.05f, -0.3f, 2.0f, got);
+                reference.quadratic_gradient(cols, 0.05f, -0.3f, 2.0f, want);
+                check_sums("quadratic_gradient", got, want, 3);
+                table->power_gradient(cols, 0.4f, 1.2f, got);
+                reference.power_gradient(cols, 0.4f, 1.2f, want);
+                check_sums("power_gradient", got, want, 2);
+                table->exponential_gradient(cols, 0.4f, 0.1f, got);
+                reference.exponential_gradient(cols, 0.4f, 0.1f, want);
+                check_sums("exponential_gradient", got, want, 2);
+
+                got[0] = table->linear_error(cols, 0.7f, 3.0f);
+                want[0] = reference.linear_error(cols, 0.7f, 3.0f);
+                check_sums("linear_error", got, want, 1);
+                got[0] = table->quadratic_error(cols, 0.05f, -0.3f, 2.0f);
+                want[0] = reference.quadratic_error(cols, 0.05f, -0.3f, 2.0f);
+                check_sums("quadratic_error", got, want, 1);
+                got[0] = table->power_error(cols, 1.5f, 1.2f);
+                want[0] = reference.power_error(cols, 1.5f, 1.2f);
+                check_sums("power_error", got, want, 1);
+                got[0] = table->exponential_error(cols, 1.5f, 1.1f);
+                want[0] = reference.exponential_error(cols, 1.5f, 1.1f);
+                check_sums("exponential_error", got, want, 1);
+
+                std::vector<float> values(n), expected(n);
+                auto check_values = [&](const char *kernel) {
+                    for (std::size_t i = 0; i < n; ++i) {
+                        CHECK(close(values[i], expected[i], 1e-6), "%s %s n=%zu cached=%u [%zu]: %.9g vs %.9g",
+                              table->name, kernel, n, cached, i, values[i], expected[i]);
+                    }
+                };
+                table->linear_values(cols, 0.7f, 3.0f, values.data());
+                reference.linear_values(cols, 0.7f, 3.0f, expected.data());
+                check_values("linear_values");
+                table->quadratic_values(cols, 0.05f, -0.3f, 2.0f, values.data());
+                reference.quadratic_values(cols, 0.05f, -0.3f, 2.0f, expected.data());
+                check_values("quadratic_values");
+                table->power_values(cols, 1.5f, 1.2f, values.data());
+                reference.power_values(cols, 1.5f, 1.2f, expected.data());
+                check_values("power_values");
+                table->exponential_values(cols, 1.5f, 1.1f, values.data());
+                reference.exponential_values(cols, 1.5f, 1.1f, expected.data());
+                check_values("exponential_values");
+                table->log(cols.x, values.data(), n);
+                reference.log(cols.x, expected.data(), n);
+                check_values("log");
+            }
+        }
+    }
+}
+
+// log and exp where std::log and std::exp have exact answers, in every lane position
+static void test_special_values() {
+    const float inputs[] {0.0f, -0.0f, -1.0f, 1.0f, INFINITY, -INFINITY, NAN, 1e-40f, 3.4e38f, 100.0f, -100.0f, 88.0f};
+    constexpr std::size_t count = sizeof(inputs) / sizeof(inputs[0]);
+    std::vector<const kernels::Table *> tables = vector_tables();
+    tables.push_back(&kernels::scalar::table);
+    for (const kernels::Table *table : tables) {
+        // repeated past the widest vector so every value also lands in a full vector
+        std::vector<float> in;
+        for (int r = 0; r < 4; ++r) in.insert(in.end(), inputs, inputs + count);
+        std::vector<float> out(in.size());
+        table->log(in.data(), out.data(), in.size());
+        for (std::size_t i = 0; i < in.size(); ++i) {
+            // the vector kernels raise denormals to the smallest normal float first
+            const bool flushed = table != &kernels::scalar::table && in[i] > 0 && in[i] < FLT_MIN;
+            const double want = std::log(flushed ? FLT_MIN : in[i]);
+            CHECK(close(out[i], want, 1e-6), "%s log(%g) = %g, std::log gives %g", table->name, in[i], out[i], want);
+        }
+        // a * b^x with a = 1, b = e is exp(x)
+        table->exponential_values({in.data(), nullptr, nullptr, nullptr, nullptr, in.size()}, 1.0f, std::exp(1.0f), out.data());
+        for (std::size_t i = 0; i < in.size(); ++i) {
+            const double want = std::exp(in[i]);
+            const bool tiny = want < 1e-37; // cephes stops at the smallest normal
+            CHECK(tiny ? out[i] < 1e-37f : close(out[i], want, 1e-5), "%s exp(%g) = %g, std::exp gives %g",
+                  table->name, in[i], out[i], want);
+        }
+    }
+}
+
+// the pool's chunks together cover every point exactly once, whatever the remainder
+static void test_reduce() {
+    ThreadPool pool(4);
+    const kernels::Table &table = kernels::active();
+    for (std::size_t n : {32767, 32768, 65536, 65537, 65551, 100003, 1048577}) {
+        const std::vector<Vector2> points = random_points(n, 7);
+        PointStore store;
+        store.assign(points.data(), n);
+        const kernels::Columns cols = store.columns();
+        double counted[1], sums[2], expected[2];
+        kernels::reduce<1>(&pool, cols, counted, [](const kernels::Columns &c, double *out) { out[0] = c.n; });
+        CHECK(counted[0] == n, "n=%zu: the chunks cover %.0f points", n, counted[0]);
+        kernels::reduce<2>(&pool, cols, sums, [&](const kernels::Columns &c, double *out) {
+            table.linear_gradient(c, 0.7f, 3.0f, out);
+        });
+        table.linear_gradient(cols, 0.7f, 3.0f, expected);
+        for (int k = 0; k < 2; ++k) {
+            CHECK(close(sums[k], expected[k], 1e-6), "n=%zu sum %d: %.9g in the pool, %.9g serially", n, k, sums[k], expected[k]);
+        }
+    }
+}
+
+// plain decimals take the fast path, the rest from_chars; both must give the correctly rounded float
+static void test_parse_float() {
+    std::mt19937 random(3);
+    std::uniform_int_distribution<int> digits(1, 18), position(0, 18), digit(0, 9), sign(0, 2);
+    int mismatches = 0;
+    for (int i = 0; i < 200000; ++i) {
+        std::string text = sign(random) == 0 ? "-" : "";
+        const int count = digits(random), point = position(random);
+        for (int d = 0; d < count; ++d) {
+            if (d == point) text += '.';
+            text += char('0' + digit(random));
+        }
+        float got = 0.0f, want = 0.0f;
+        const char *end = dataset::parse_float(text.data(), text.data() + text.size(), got);
+        std::from_chars(text.data(), text.data() + text.size(), want);
+        if (end != text.data() + text.size() || got != want) mismatches += 1;
+    }
+    CHECK(mismatches == 0, "%d of 200000 numbers differ from from_chars", mismatches);
+
+    std::size_t skipped = 0;
+    const std::string csv = "x,y\n1.5,2\n3;4.25\r\n\n  5\t6\nbad line\n-7e1 8\n";
+    const std::vector<Vector2> points = dataset::parse_csv(nullptr, csv.data(), csv.size(), skipped);
+    CHECK(points.size() == 4 && skipped == 2, "parsed %zu points, skipped %zu", points.size(), skipped);
+    CHECK(points.size() == 4 && points[3].x == -70.0f && points[3].y == 8.0f, "last point");
+
+    // text without a single point is not a dataset: the load fails and nothing is fed
+    char path[] = "/tmp/regressions-test-XXXXXX";
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0, "mkstemp");
+    if (fd < 0) return;
+    const char text[] = "Permission is hereby granted, free of charge,\nto any person obtaining a copy\n";
+    CHECK(write(fd, text, sizeof(text) - 1) == ssize_t(sizeof(text) - 1), "write");
+    ::close(fd);
+    bool fed = false;
+    const dataset::Report report = dataset::load(path, nullptr, [&](const Vector2 *, std::size_t) { fed = true; });
+    CHECK(!report.ok && !fed, "a file without points loaded: ok=%d fed=%d", report.ok, fed);
+    std::remove(path);
+}
+
+// one producer and one consumer: everything arrives, once and in order
+static void test_spsc_queue() {
+    constexpr std::size_t total = 1000000;
+    SpscQueue<std::size_t> queue(1024);
+    std::thread producer([&] {
+        for (std::size_t i = 0; i < total; ++i) {
+            while (!queue.push(i)) std::this_thread::yield();
+        }
+    });
+    std::size_t expected = 0, buffer[256];
+    bool ordered = true;
+    while (expected < total) {
+        const std::size_t got = queue.pop(buffer, 256);
+        for (std::size_t i = 0; i < got; ++i) ordered = ordered && buffer[i] == expected++;
+        if (got == 0) std::this_thread::yield();
+    }
+    producer.join();
+    CHECK(ordered, "items out of order or repeated");
+}
+
+/* leaving Decay for Window the way main does it: decayed sums are rebuilt from the points kept,
+ * never downdated, so they end up the same as a fresh fit over those points
+ */
+static void test_history_switch() {
+    const std::vector<Vector2> points = random_points(100, 9);
+    PointStore data;
+    LinearRegression lr;
+    lr.forgetting = 0.9;
+    for (auto point : points) {
+        data.push_back(point);
+        lr.add_point(point);
+    }
+    const LinearStats decayed = lr.statistics();
+    lr.remove_point(points[0]);
+    lr.remove_points(points.data(), 10); // e.g. pushed out of the display window
+    CHECK(std::memcmp(&decayed, &lr.statistics(), sizeof(decayed)) == 0, "removing points changed decayed sums");
+
+    data.set_window(50);
+    lr.forgetting = 1.0;
+    std::vector<Vector2> kept;
+    for (auto point : data) kept.push_back(point);
+    lr.forget_points();
+    lr.add_points(kept.data(), kept.size());
+    LinearRegression fresh;
+    fresh.add_points(points.data() + 50, 50);
+    CHECK(lr.statistics().n == 50, "%g points in the sums", lr.statistics().n);
+    CHECK(std::memcmp(&lr.statistics(), &fresh.statistics(), sizeof(LinearStats)) == 0, "sums differ from a fresh fit");
+}
+
+// taking a batch back out leaves the sums of a fresh fit over the rest
+static void test_remove_points() {
+    const std::vector<Vector2> points = random_points(3000, 11);
+    auto check = [&](auto regression, const char *name) {
+        decltype(regression) fresh;
+        regression.add_points(points.data(), points.size());
+        regression.remove_points(points.data(), 1000);
+        fresh.add_points(points.data() + 1000, 2000);
+        CHECK(regression.statistics().n == fresh.statistics().n, "%s: %g points", name, regression.statistics().n);
+        const auto got = regression.calculated.parameters(), want = fresh.calculated.parameters();
+        for (std::size_t i = 0; i < got.size(); ++i) {
+            CHECK(close(got[i], want[i], 1e-4), "%s parameter %zu: %g vs %g", name, i, got[i], want[i]);
+        }
+    };
+    check(LinearRegression(), "linear");
+    check(QuadraticRegression(), "quadratic");
+    check(PowerRegression(), "power");
+    check(ExponentialRegression(), "exponential");
+}
+
+/* bulk loading sharded over a pool against add_points on one thread, with and without forgetting;
+ * the shards sum in another order, so the sums agree to rounding rather than bit for bit
+ */
+static void test_sharded_add_points() {
+    ThreadPool pool(4);
+    const std::vector<Vector2> points = random_points(100003, 13); // a few shards of at least 2^14, and a remainder
+    auto check = [&](auto serial, const char *name) {
+        for (double lambda : {1.0, 0.9999}) {
+            decltype(serial) sharded;
+            serial.reset();
+            serial.forgetting = sharded.forgetting = lambda;
+            serial.add_points(points.data(), points.size());
+            add_points(sharded, &pool, points.data(), points.size());
+            // the stats are plain structs of sums
+            constexpr std::size_t count = sizeof(serial.statistics()) / sizeof(double);
+            const double *got = reinterpret_cast<const double *>(&sharded.statistics());
+            const double *want = reinterpret_cast<const double *>(&serial.statistics());
+            for (std::size_t i = 0; i < count; ++i) {
+                CHECK(close(got[i], want[i], 1e-12), "%s lambda=%g sum %zu: %.17g vs %.17g", name, lambda, i, got[i], want[i]);
+            }
+            const auto p = sharded.calculated.parameters(), q = serial.calculated.parameters();
+            for (std::size_t i = 0; i < p.size(); ++i) {
+                CHECK(close(p[i], q[i], 1e-6), "%s lambda=%g parameter %zu: %g vs %g", name, lambda, i, p[i], q[i]);
+            }
+        }
+    };
+    check(LinearRegression(), "linear");
+    check(QuadraticRegression(), "quadratic");
+    check(PowerRegression(), "power");
+    check(ExponentialRegression(), "exponential");
+}
+
+// the mean squared error from the running sums is the one a scan of the points gives
+static void test_error_from_sums() {
+    const std::vector<Vector2> points = random_points(5000, 17);
+    PointStore data;
+    data.assign(points.data(), points.size());
+    LinearRegression lr;
+    QuadraticRegression qr;
+    lr.add_points(points.data(), points.size());
+    qr.add_points(points.data(), points.size());
+    LinearFunction line;
+    line.a = 3.0f;
+    line.b = -20.0f;
+    QuadraticFunction parabola;
+    parabola.a = 0.5f;
+    parabola.b = 4.0f;
+    parabola.c = 100.0f;
+    for (const LinearFunction &f : {lr.calculated, line}) {
+        const float sums = lr.current_error(f, data), scan = f.current_error(data);
+        CHECK(close(sums, scan, 1e-4), "linear: %g from the sums, %g by scan", sums, scan);
+    }
+    for (const QuadraticFunction &f : {qr.calculated, parabola}) {
+        const float sums = qr.current_error(f, data), scan = f.current_error(data);
+        CHECK(close(sums, scan, 1e-4), "quadratic: %g from the sums, %g by scan", sums, scan);
+    }
+}
+
+// one descent step from the running sums lands where one step from a scan of the points does
+static void test_descent_from_moments() {
+    const std::vector<Vector2> points = random_points(5000, 19);
+    PointStore data;
+    data.assign(points.data(), points.size());
+    auto check = [&](auto scan, const char *name) {
+        decltype(scan) moments;
+        scan.add_points(points.data(), points.size());
+        moments.add_points(points.data(), points.size());
+        moments.from_moments = true;
+        const auto start = scan.descent.parameters();
+        scan.descent_step(data);
+        moments.descent_step(data);
+        const auto p = moments.descent.parameters(), q = scan.descent.parameters();
+        for (std::size_t i = 0; i < p.size(); ++i) {
+            // relative even for the tiny first steps, e.g. of the quadratic's a
+            const bool same = std::abs(p[i] - q[i]) <= 1e-5 * std::max(std::abs(p[i]), std::abs(q[i]));
+            CHECK(same && p[i] != start[i], "%s parameter %zu: %.9g from the sums, %.9g by scan", name, i, p[i], q[i]);
+        }
+    };
+    check(LinearRegression(), "linear");
+    check(QuadraticRegression(), "quadratic");
+    check(PowerRegression(), "power");
+    check(ExponentialRegression(), "exponential");
+}
+
+// a saved session loads back bit for bit, and a damaged file leaves the session alone
+static void test_snapshot() {
+    const std::vector<Vector2> points = random_points(1000, 5);
+    PointStore data(PointStore::LNX | PointStore::LNY, 600);
+    LinearRegression lr;
+    QuadraticRegression qr;
+    PowerRegression pr;
+    ExponentialRegression er;
+    for (auto point : points) {
+        if (auto evicted = data.push_back(point)) {
+            lr.remove_point(*evicted);
+            qr.remove_point(*evicted);
+            pr.remove_point(*evicted);
+            er.remove_point(*evicted);
+        }
+        lr.add_point(point);
+        qr.add_point(point);
+        pr.add_point(point);
+        er.add_point(point);
+    }
+    for (int i = 0; i < 10; ++i) {
+        lr.descent_step(data);
+        pr.descent_step(data);
+    }
+    char path[] = "/tmp/regressions-test-XXXXXX";
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0, "mkstemp");
+    if (fd < 0) return;
+    close(fd);
+    CHECK(snapshot::save(path, data, {lr, qr, pr, er}), "save");
+
+    PointStore loaded;
+    LinearRegression lr2;
+    QuadraticRegression qr2;
+    PowerRegression pr2;
+    ExponentialRegression er2;
+    CHECK(snapshot::load(path, loaded, {lr2, qr2, pr2, er2}), "load");
+    CHECK(loaded.size() == data.size() && loaded.capacity() == data.capacity(), "%zu points of %zu", loaded.size(), data.size());
+    bool same_points = loaded.size() == data.size();
+    for (std::size_t i = 0; same_points && i < data.size(); ++i) {
+        same_points = loaded[i].x == data[i].x && loaded[i].y == data[i].y;
+    }
+    CHECK(same_points, "points differ");
+    CHECK(std::memcmp(&lr.statistics(), &lr2.statistics(), sizeof(lr.statistics())) == 0, "linear sums differ");
+    CHECK(std::memcmp(&qr.statistics(), &qr2.statistics(), sizeof(qr.statistics())) == 0, "quadratic sums differ");
+    CHECK(lr.descent.parameters() == lr2.descent.parameters() && pr.descent.parameters() == pr2.descent.parameters(), "descent differs");
+    CHECK(qr.calculated.parameters() == qr2.calculated.parameters(), "quadratic fit differs");
+
+    // one field of the header at a time, each rejected before the session is touched
+    auto damaged = [&](long offset, auto value, const char *field) {
+        CHECK(snapshot::save(path, data, {lr, qr, pr, er}), "save");
+        std::FILE *file = std::fopen(path, "r+b");
+        std::fseek(file, offset, SEEK_SET);
+        std::fwrite(&value, sizeof(value), 1, file);
+        std::fclose(file);
+        CHECK(!snapshot::load(path, loaded, {lr2, qr2, pr2, er2}), "a file with a damaged %s loaded", field);
+        CHECK(loaded.size() == data.size() && loaded.capacity() == data.capacity(), "a rejected %s changed the session", field);
+    };
+    damaged(offsetof(snapshot::Header, version), std::uint32_t(0x7f), "version");
+    damaged(offsetof(snapshot::Header, window), std::uint64_t(1) << 60, "window");
+    damaged(offsetof(snapshot::Header, window), std::uint64_t(10), "window below the points");
+    damaged(offsetof(snapshot::Header, forgetting), 0.0, "forgetting");
+    damaged(offsetof(snapshot::Header, forgetting), 1.5, "forgetting");
+    damaged(offsetof(snapshot::Header, forgetting), double(NAN), "forgetting");
+    std::remove(path);
+}
+
+int main() {
+    test_kernels();
+    test_special_values();
+    test_reduce();
+    test_parse_float();
+    test_spsc_queue();
+    test_history_switch();
+    test_remove_points();
+    test_sharded_add_points();
+    test_error_from_sums();
+    test_descent_from_moments();
+    test_snapshot();
+    if (failures) {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("all checks passed (%s kernels)\n", kernels::active().name);
+    return 0;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* a fixed set of workers that live as long as the pool,
+ * run() hands out task indices to them and to the calling thread
+ */
+struct ThreadPool {
+    explicit ThreadPool(unsigned threads = std::max(1u, std::thread::hardware_concurrency())) {
+        for (unsigned i = 1; i < threads; ++i) {
+            workers.emplace_back([this] { work(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned size() const { return workers.size() + 1; } // the caller counts as a thread
+
+    // calls task(i) for every i in [0, count), returns once all of them are done
+    // concurrent callers (e.g. several solvers) take turns
+    void run(std::size_t count, const std::function<void(std::size_t)> &task) {
+        std::lock_guard<std::mutex> turn(run_mutex);
+        std::unique_lock<std::mutex> lock(mutex);
+        // a worker that woke up late for the previous run must be out before the state changes
+        done.wait(lock, [this] { return active == 0; });
+        current = &task;
+        total = count;
+        next = 0;
+        remaining = count;
+        ++generation;
+        lock.unlock();
+        wake.notify_all();
+
+        drain();
+
+        lock.lock();
+        done.wait(lock, [this] { return remaining == 0 && active == 0; });
+        current = nullptr;
+    }
+
+    private:
+        void drain() {
+            for (;;) {
+                const std::size_t i = next.fetch_add(1);
+                if (i >= total) break;
+                (*current)(i);
+                if (remaining.fetch_sub(1) == 1) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done.notify_all();
+                }
+            }
+        }
+
+        void work() {
+            std::size_t seen = 0;
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                ++active;
+                lock.unlock();
+                drain();
+                lock.lock();
+                if (--active == 0) done.notify_all();
+            }
+        }
+
+        std::vector<std::thread> workers;
+        std::mutex run_mutex, mutex;
+        std::condition_variable wake, done;
+        const std::function<void(std::size_t)> *current = nullptr;
+        std::size_t total = 0;
+        std::atomic<std::size_t> next{0}, remaining{0};
+        std::size_t generation = 0;
+        unsigned active = 0;
+        bool stopping = false;
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+/* the only raylib type the numeric code needs; a headless build defines HEADLESS
+ * and gets a layout compatible stand-in instead of the raylib header
+ */
+#ifdef HEADLESS
+struct Vector2 {
+    float x;
+    float y;
+};
+#else
+#include <raylib.h>
+#endif